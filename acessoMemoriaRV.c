@@ -1,186 +1,719 @@
-/**
- * Trabalho 1 - Organização e Arquitetura de Computadores
- * UnB - 2020/2
- * @author Pedro Nogueira - 14/0065032
- *
- * Este trabalho consiste na simulação das instruções de acesso à memória do
- * RISCV RV32I em linguagem C.
- */
-#include <stdbool.h>
-#include <stdint.h>
-#include <stdio.h>
-
-// A memória é simulada como um arranjo de inteiros de 32 bits.
-// Ou seja, a memória é um arranjo de 4KWords, ou 16KBytes.
-#define MEM_SIZE 4096
-int32_t mem[MEM_SIZE];
-
-typedef bool uint1_t;  // somente usado para ints de 1 bit só
-
-#define BYTE1AND 0x000000FF  // 00000000 00000000 00000000 11111111
-#define BYTE2AND 0x0000FF00  // 00000000 00000000 11111111 00000000
-#define BYTE3AND 0x00FF0000  // 00000000 11111111 00000000 00000000
-#define BYTE4AND 0xFF000000  // 11111111 00000000 00000000 00000000
-
-#define BYTE1OR 0xFFFFFF00  // 11111111 11111111 11111111 00000000
-#define BYTE2OR 0xFFFF00FF  // 11111111 11111111 00000000 11111111
-#define BYTE3OR 0xFF00FFFF  // 11111111 00000000 11111111 11111111
-#define BYTE4OR 0x00FFFFFF  // 00000000 11111111 11111111 11111111
-
-#define ALLONE 0xFFFFFFFF  // 11111111 11111111 11111111 11111111
-
-/**
- * Lê um inteiro alinhado - endereços múltiplos de 4.
- * A função calcula o endereço de memória somando os parâmetros:
- * Endereço palavra = address + kte
- * A função deve checar se o endereço é um múltiplo de 4 (%4 == 0).
- * Se não for, deve escrever uma mensagem de erro e retornar zero.
- * Se o endereço estiver correto, a função deve:
- * • Dividi-lo por 4 para obter o índice do vetor memória
- * • Retornar o o valor lido da memória
- */
-int32_t lw(uint32_t address, int32_t kte) {
-  if ((address + kte) % 4 != 0) {
-    printf("Error reading the address in lw - address not multiple of 4!\n");
-    return 0;
-  }
-  return mem[(address + kte) / 4];
-}
-
-/**
- * Lê um byte do vetor memória e retorna-o, estendendo o sinal para 32 bits.
- * Lembrando que as palavras da memória tem 4 bytes cada, para acessar um byte
- * dentro da palavra pode-se:
- * • Ler a palavra que contém o byte e, por operações de mascaramento, extrair
- * byte endereçado, ou
- * • Criar um ponteiro para byte e fazer um type cast (coerção de tipo) do
- * endereço do vetor memória (int *) para byte (char *).
- */
-int32_t lb(uint32_t address, int32_t kte) {
-  uint1_t signal;
-  int32_t word = mem[(address + kte) / 4];
-  uint32_t byte = (address + kte) % 4;
-  int32_t result;
-  switch (byte) {
-    case 0:
-      result = (word & BYTE1AND);
-      break;
-    case 1:
-      result = (word & BYTE2AND) >> 8;
-      break;
-    case 2:
-      result = (word & BYTE3AND) >> 16;
-      break;
-    case 3:
-      result = (word & BYTE4AND) >> 24;
-      break;
-  }
-  signal = result >> 3;
-  return signal ? (result | BYTE1OR) : result;
-}
-
-/**
- * Lê um byte do vetor memória e retorna-o como um número positivo, ou seja,
- * todos os bits superiores devem ser zerados.
- */
-int32_t lbu(uint32_t address, int32_t kte) {
-  int32_t word = mem[(address + kte) / 4];
-  uint32_t byte = (address + kte) % 4;
-  int32_t result;
-  switch (byte) {
-    case 0:
-      result = (word & BYTE1AND);
-      break;
-    case 1:
-      result = (word & BYTE2AND) >> 8;
-      break;
-    case 2:
-      result = (word & BYTE3AND) >> 16;
-      break;
-    case 3:
-      result = (word & BYTE4AND) >> 24;
-      break;
-  }
-  return result;
-}
-
-/**
- * Escreve um inteiro alinhado na memória - endereços múltiplos de 4. O cálculo
- * do endereço é realizado da mesma forma que na operação lw().
- */
-void sw(uint32_t address, int32_t kte, int32_t dado) {
-  if ((address + kte) % 4 != 0) {
-    printf("Error saving the word in sw - address not multiple of 4!\n");
-    return;
-  }
-  mem[(address + kte) / 4] = dado;
-}
-
-/**
- * Escreve um byte na memória. Caso utilize operações de mascaramento, a palavra
- * que contém o byte deve ser lida da memória, o byte deve ser posicionado
- * corretamente através de deslocamentos e a escrita ocorre utilizando máscaras.
- * Alternativamente pode-se utilizar a coerção para (char *) e escrever
- * diretamente na posição usando o endereço calculado como índice.
- */
-void sb(uint32_t address, int32_t kte, int8_t dado) {
-  int32_t word = mem[(address + kte) / 4];
-  int32_t dado32bit = dado;
-  dado32bit = dado32bit & BYTE1AND;
-  int32_t byteMask = dado32bit << (kte * 8);
-  int32_t result;
-  switch (kte) {
-    case 0:
-      result = (word & BYTE1OR) | byteMask;
-      break;
-    case 1:
-      result = (word & BYTE2OR) | byteMask;
-      break;
-    case 2:
-      result = (word & BYTE3OR) | byteMask;
-      break;
-    case 3:
-      result = (word & BYTE4OR) | byteMask;
-      break;
-  }
-  mem[(address + kte) / 4] = result;
-}
-/*
-int main() {
-  sb(0, 0, 0x04);
-  sb(0, 1, 0x03);
-  sb(0, 2, 0x02);
-  sb(0, 3, 0x01);
-
-  sb(4, 0, 0xFF);
-  sb(4, 2, 0xFD);
-  sb(4, 3, 0xFC);
-
-  sw(12, 0, 0xFF);
-  sw(16, 0, 0xFFFF);
-  sw(20, 0, 0xFFFFFFFF);
-  sw(24, 0, 0x80000000);
-
-  printf("mem[0] = %08x\n", mem[0]);
-  printf("mem[1] = %08x\n", mem[1]);
-  printf("mem[2] = %08x\n", mem[2]);
-  printf("mem[3] = %08x\n", mem[3]);
-  printf("mem[4] = %08x\n", mem[4]);
-  printf("mem[5] = %08x\n", mem[5]);
-  printf("mem[6] = %08x\n", mem[6]);
-
-  printf("lb(4,0) = %08x\n", lb(4, 0));
-  printf("lb(4,1) = %08x\n", lb(4, 1));
-  printf("lb(4,2) = %08x\n", lb(4, 2));
-  printf("lb(4,3) = %08x\n", lb(4, 3));
-  printf("lbu(4,0) = %08x\n", lbu(4, 0));
-  printf("lbu(4,1) = %08x\n", lbu(4, 1));
-  printf("lbu(4,2) = %08x\n", lbu(4, 2));
-  printf("lbu(4,3) = %08x\n", lbu(4, 3));
-  printf("lw(12,0) = %08x\n", lw(12, 0));
-  printf("lw(16,0) = %08x\n", lw(16, 0));
-  printf("lw(20,0) = %08x\n", lw(20, 0));
-
-  return 0;
-}
+/**
+ * Trabalho 1 - Organização e Arquitetura de Computadores
+ * UnB - 2020/2
+ * @author Pedro Nogueira - 14/0065032
+ *
+ * Este trabalho consiste na simulação das instruções de acesso à memória do
+ * RISCV RV32I em linguagem C.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __unix__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// A memória cobre todo o espaço de 32 bits, dividido em páginas de 4 KiB
+// (1K palavras). Uma tabela de dois níveis aponta para as páginas: o primeiro
+// nível é indexado pelos bits 31:22 do endereço e o segundo pelos bits 21:12.
+// Uma página só pode ser acessada depois de mapeada com mem_map(), e só ocupa
+// memória do host depois da primeira escrita: até lá ela aponta para
+// mem_zero_page, compartilhada e somente de leitura.
+// Acesso a página não mapeada é uma falta: a leitura devolve zero, a escrita
+// é descartada e o endereço fica registrado em fault/fault_address.
+// Cada processador (Hart) tem a sua Memory e a passa para as funções abaixo.
+// Vários harts podem usar a mesma tabela de páginas (mem_share), cada um com
+// a sua TLB e o seu registro de faltas.
+#define PAGE_BITS 12
+#define PAGE_BYTES (1 << PAGE_BITS)
+#define PAGE_WORDS (PAGE_BYTES / 4)
+#define TABLE_BITS 10
+#define TABLE_SIZE (1 << TABLE_BITS)
+
+// Região mapeada por padrão, a antiga memória de 4KWords (16KBytes) com o
+// texto, os dados e a pilha do RARS.
+#define MEM_SIZE 4096
+
+#define BYTE1AND 0x000000FF  // 00000000 00000000 00000000 11111111
+
+#define ALLONE 0xFFFFFFFF  // 11111111 11111111 11111111 11111111
+
+// Arquivos carregados com mmap (ver mem_load_file). As páginas deles apontam
+// direto para o mapeamento, então não são liberadas com free().
+#define MEM_MAX_FILES 8
+
+typedef struct {
+  uint8_t *base;
+  size_t size;
+} MemFile;
+
+typedef struct {
+  // Primeiro nível da tabela de páginas em uso: own_tables ou o de outra
+  // memória (mem_share)
+  int32_t ***tables;
+  int32_t **own_tables[TABLE_SIZE];
+  // As páginas novas são alocadas já no mem_map(), e não na primeira escrita,
+  // para as entradas da tabela não mudarem mais (ver mem_make_private)
+  bool eager;
+  // TLB de uma entrada para leitura e outra para escrita: número e endereço
+  // da última página acessada. ALLONE nunca é um número de página válido.
+  uint32_t read_tag, write_tag;
+  int32_t *read_page, *write_page;
+  bool fault;              // houve acesso a endereço não mapeado
+  uint32_t fault_address;  // endereço do primeiro acesso inválido
+  // Destino das mensagens de erro das funções abaixo. Se report for nulo elas
+  // vão para a saída padrão.
+  void (*report)(void *owner, const char *text);
+  void *owner;
+  MemFile files[MEM_MAX_FILES];
+  int file_count;
+  // Páginas de um snapshot (ver snapshot.cpp), divididas com outras memórias
+  // restauradas do mesmo snapshot. Ficam em [shared_base, shared_base +
+  // shared_size), nunca são escritas e são copiadas na primeira escrita.
+  const uint8_t *shared_base;
+  size_t shared_size;
+} Memory;
+
+// Conteúdo de todas as páginas mapeadas que ainda não foram escritas
+int32_t mem_zero_page[PAGE_WORDS];
+
+void mem_init(Memory *mem) {
+  memset(mem, 0, sizeof(Memory));
+  mem->tables = mem->own_tables;
+  mem->read_tag = ALLONE;
+  mem->write_tag = ALLONE;
+}
+
+/**
+ * Diz se a página pertence a um arquivo carregado com mmap.
+ */
+bool mem_file_page(Memory *mem, int32_t *page) {
+  for (int i = 0; i < mem->file_count; i++) {
+    uint8_t *p = (uint8_t *)page;
+    if (p >= mem->files[i].base && p < mem->files[i].base + mem->files[i].size) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Diz se a página pertence ao snapshot de onde a memória foi restaurada.
+ */
+bool mem_shared_page(Memory *mem, int32_t *page) {
+  uint8_t *p = (uint8_t *)page;
+  return p >= mem->shared_base && p < mem->shared_base + mem->shared_size;
+}
+
+/**
+ * Libera todas as páginas e tabelas. A memória volta a não ter nada mapeado,
+ * mas continua com o mesmo destino de mensagens. As páginas de uma tabela
+ * emprestada com mem_share() não são liberadas, elas são da outra memória.
+ */
+void mem_release(Memory *mem) {
+  for (int i = 0; i < TABLE_SIZE && mem->tables == mem->own_tables; i++) {
+    int32_t **table = mem->tables[i];
+    if (table == NULL) {
+      continue;
+    }
+    for (int j = 0; j < TABLE_SIZE; j++) {
+      if (table[j] != mem_zero_page && !mem_file_page(mem, table[j]) &&
+          !mem_shared_page(mem, table[j])) {
+        free(table[j]);
+      }
+    }
+    free(table);
+  }
+#ifdef __unix__
+  for (int i = 0; i < mem->file_count; i++) {
+    munmap(mem->files[i].base, mem->files[i].size);
+  }
+#endif
+  void (*report)(void *, const char *) = mem->report;
+  void *owner = mem->owner;
+  mem_init(mem);
+  mem->report = report;
+  mem->owner = owner;
+}
+
+/**
+ * Mapeia as páginas que contêm [start, start + size). As páginas novas ficam
+ * zeradas e só são alocadas na primeira escrita (ou já aqui, se a memória é
+ * eager). Páginas já mapeadas não são alteradas.
+ */
+void mem_map(Memory *mem, uint32_t start, uint32_t size) {
+  if (size == 0) {
+    return;
+  }
+  uint64_t end = (uint64_t)start + size - 1;
+  if (end > ALLONE) {
+    end = ALLONE;
+  }
+  for (uint32_t page = start >> PAGE_BITS; page <= (end >> PAGE_BITS);
+       page++) {
+    int32_t ***table = &mem->tables[page >> TABLE_BITS];
+    if (*table == NULL) {
+      *table = (int32_t **)calloc(TABLE_SIZE, sizeof(int32_t *));
+    }
+    int32_t **entry = &(*table)[page & (TABLE_SIZE - 1)];
+    if (*entry == NULL && mem->eager) {
+      *entry = (int32_t *)calloc(PAGE_WORDS, sizeof(int32_t));
+    }
+    if (*entry == NULL) {
+      *entry = mem_zero_page;
+    }
+  }
+}
+
+/**
+ * Entrada da tabela para a página de address, ou NULL se não existe tabela de
+ * segundo nível para ela.
+ */
+int32_t **mem_entry(Memory *mem, uint32_t address) {
+  int32_t **table = mem->tables[address >> (PAGE_BITS + TABLE_BITS)];
+  if (table == NULL) {
+    return NULL;
+  }
+  return &table[(address >> PAGE_BITS) & (TABLE_SIZE - 1)];
+}
+
+/**
+ * Diz se o endereço está numa página mapeada, sem registrar falta.
+ */
+bool mem_mapped(Memory *mem, uint32_t address) {
+  int32_t **entry = mem_entry(mem, address);
+  return entry != NULL && *entry != NULL;
+}
+
+/**
+ * Escreve uma mensagem de erro no destino da memória.
+ */
+void mem_report(Memory *mem, const char *text) {
+  if (mem->report != NULL) {
+    mem->report(mem->owner, text);
+  } else {
+    fputs(text, stdout);
+  }
+}
+
+/**
+ * Registra a falta. Somente o primeiro endereço inválido é guardado.
+ */
+uint8_t *mem_fault(Memory *mem, uint32_t address) {
+  if (!mem->fault) {
+    mem->fault = true;
+    mem->fault_address = address;
+  }
+  return NULL;
+}
+
+/**
+ * Devolve o endereço no host do byte address para leitura, ou NULL em caso de
+ * falta. O caminho rápido é a página da última leitura.
+ */
+uint8_t *mem_read_ptr(Memory *mem, uint32_t address) {
+  uint32_t tag = address >> PAGE_BITS;
+  if (tag != mem->read_tag) {
+    int32_t **entry = mem_entry(mem, address);
+    if (entry == NULL || *entry == NULL) {
+      return mem_fault(mem, address);
+    }
+    mem->read_tag = tag;
+    mem->read_page = *entry;
+  }
+  return (uint8_t *)mem->read_page + (address & (PAGE_BYTES - 1));
+}
+
+/**
+ * Devolve o endereço no host do byte address para escrita, ou NULL em caso de
+ * falta. Na primeira escrita numa página ela é alocada no host, com uma cópia
+ * do conteúdo se ela era de um snapshot.
+ */
+uint8_t *mem_write_ptr(Memory *mem, uint32_t address) {
+  uint32_t tag = address >> PAGE_BITS;
+  if (tag != mem->write_tag) {
+    int32_t **entry = mem_entry(mem, address);
+    if (entry == NULL || *entry == NULL) {
+      return mem_fault(mem, address);
+    }
+    if (*entry == mem_zero_page || mem_shared_page(mem, *entry)) {
+      int32_t *page = (int32_t *)malloc(PAGE_BYTES);
+      if (page == NULL) {
+        return mem_fault(mem, address);
+      }
+      memcpy(page, *entry, PAGE_BYTES);
+      *entry = page;
+      if (mem->read_tag == tag) {
+        mem->read_page = page;
+      }
+    }
+    mem->write_tag = tag;
+    mem->write_page = *entry;
+  }
+  return (uint8_t *)mem->write_page + (address & (PAGE_BYTES - 1));
+}
+
+/**
+ * Mapeia a página de address apontando para page, uma página de snapshot
+ * dentro de [mem->shared_base, mem->shared_base + mem->shared_size). Nada é
+ * copiado: a página só é copiada na primeira escrita.
+ */
+void mem_map_shared(Memory *mem, uint32_t address, const int32_t *page) {
+  mem_map(mem, address, PAGE_BYTES);
+  *mem_entry(mem, address) = (int32_t *)page;
+  if (mem->read_tag == address >> PAGE_BITS) {
+    mem->read_tag = ALLONE;
+  }
+  if (mem->write_tag == address >> PAGE_BITS) {
+    mem->write_tag = ALLONE;
+  }
+}
+
+/**
+ * Troca as páginas ainda não escritas (a página zerada e as de snapshot) por
+ * cópias próprias e passa a alocar as páginas novas no mem_map(). Depois
+ * disso a tabela só muda quando uma página é mapeada, então outras memórias
+ * podem usá-la ao mesmo tempo (mem_share) sem que a TLB delas fique velha.
+ * Devolve false se faltou memória no host.
+ */
+bool mem_make_private(Memory *mem) {
+  mem->eager = true;
+  mem->read_tag = ALLONE;
+  mem->write_tag = ALLONE;
+  for (int i = 0; i < TABLE_SIZE; i++) {
+    int32_t **table = mem->tables[i];
+    for (int j = 0; table != NULL && j < TABLE_SIZE; j++) {
+      if (table[j] == mem_zero_page || mem_shared_page(mem, table[j])) {
+        int32_t *page = (int32_t *)malloc(PAGE_BYTES);
+        if (page == NULL) {
+          return false;
+        }
+        memcpy(page, table[j], PAGE_BYTES);
+        table[j] = page;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * Faz mem usar a tabela de páginas de from, que precisa ter passado por
+ * mem_make_private(). O que mem tinha mapeado é liberado. As duas memórias
+ * veem as mesmas páginas, com TLBs e faltas separadas, e from precisa viver
+ * mais que mem.
+ */
+void mem_share(Memory *mem, Memory *from) {
+  mem_release(mem);
+  mem->tables = from->tables;
+  mem->eager = true;
+}
+
+/**
+ * Chama visit para cada página mapeada, em ordem de endereço, com o endereço
+ * da página e o conteúdo dela (mem_zero_page se ela nunca foi escrita).
+ */
+void mem_for_each_page(Memory *mem,
+                       void (*visit)(void *ctx, uint32_t address,
+                                     const int32_t *page),
+                       void *ctx) {
+  for (uint32_t i = 0; i < TABLE_SIZE; i++) {
+    int32_t **table = mem->tables[i];
+    if (table == NULL) {
+      continue;
+    }
+    for (uint32_t j = 0; j < TABLE_SIZE; j++) {
+      if (table[j] != NULL) {
+        visit(ctx, (i << TABLE_BITS | j) << PAGE_BITS, table[j]);
+      }
+    }
+  }
+}
+
+#ifdef __unix__
+/**
+ * Mapeia o trecho [offset, offset + size) do arquivo com mmap copy-on-write
+ * (MAP_PRIVATE) no endereço start e aponta as páginas da memória direto para
+ * o mapeamento: nada é copiado, e vários harts que carregam o mesmo arquivo
+ * compartilham as páginas físicas até escreverem nelas. Os bytes do arquivo
+ * que caem nas páginas mas fora do trecho são zerados. Só funciona se start e
+ * offset têm o mesmo deslocamento dentro da página e se as páginas de destino
+ * ainda não têm conteúdo. Devolve size, ou -1 se não foi possível mapear.
+ */
+int64_t mem_map_file(Memory *mem, int fd, uint64_t offset, uint64_t size,
+                     uint32_t start) {
+  struct stat st;
+  uint32_t delta = start & (PAGE_BYTES - 1);
+  if (size == 0 || offset % PAGE_BYTES != delta ||
+      mem->file_count == MEM_MAX_FILES || fstat(fd, &st) != 0 ||
+      offset + size > (uint64_t)st.st_size ||
+      size > (uint64_t)ALLONE - start + 1) {
+    return -1;
+  }
+  uint32_t first = start - delta;
+  size_t length = size + delta;
+  size_t pages = (length + PAGE_BYTES - 1) / PAGE_BYTES;
+  for (size_t i = 0; i < pages; i++) {
+    int32_t **entry = mem_entry(mem, first + i * PAGE_BYTES);
+    if (entry != NULL && *entry != NULL && *entry != mem_zero_page) {
+      return -1;
+    }
+  }
+  uint8_t *base = (uint8_t *)mmap(NULL, length, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE, fd, offset - delta);
+  if (base == MAP_FAILED) {
+    return -1;
+  }
+  // depois do fim do arquivo o mmap ja devolve zeros
+  memset(base, 0, delta);
+  if (offset + size < (uint64_t)st.st_size && length % PAGE_BYTES != 0) {
+    memset(base + length, 0, PAGE_BYTES - length % PAGE_BYTES);
+  }
+  mem_map(mem, first, length);
+  for (size_t i = 0; i < pages; i++) {
+    *mem_entry(mem, first + i * PAGE_BYTES) =
+        (int32_t *)(base + i * PAGE_BYTES);
+  }
+  mem->files[mem->file_count].base = base;
+  mem->files[mem->file_count].size = pages * PAGE_BYTES;
+  mem->file_count++;
+  // a TLB pode estar apontando para a página zerada que foi substituída
+  mem->read_tag = ALLONE;
+  mem->write_tag = ALLONE;
+  return size;
+}
+#endif
+
+/**
+ * Copia até limit bytes do arquivo, a partir da posição atual, para a memória
+ * em blocos de até uma página, mapeando as páginas que eles ocupam. Devolve o
+ * número de bytes copiados.
+ */
+int64_t mem_copy_file(Memory *mem, FILE *fptr, uint32_t start,
+                      uint64_t limit) {
+  uint8_t buffer[PAGE_BYTES];
+  uint32_t address = start;
+  int64_t size = 0;
+  while ((uint64_t)size < limit) {
+    size_t room = PAGE_BYTES - (address & (PAGE_BYTES - 1));
+    if (room > limit - size) {
+      room = limit - size;
+    }
+    size_t n = fread(buffer, 1, room, fptr);
+    if (n == 0) {
+      break;
+    }
+    mem_map(mem, address, n);
+    uint8_t *page = mem_write_ptr(mem, address & ~(PAGE_BYTES - 1));
+    if (page == NULL) {
+      break;
+    }
+    memcpy(page + (address & (PAGE_BYTES - 1)), buffer, n);
+    address += n;
+    size += n;
+    if (n < room) {
+      break;
+    }
+  }
+  return size;
+}
+
+/**
+ * Carrega o arquivo fn inteiro a partir do endereço start. Tenta o mmap e, se
+ * não der, copia o arquivo. Devolve o tamanho em bytes ou -1 se o arquivo não
+ * abrir.
+ */
+int64_t mem_load_file(Memory *mem, const char *fn, uint32_t start) {
+  FILE *fptr = fopen(fn, "rb");
+  if (fptr == NULL) {
+    return -1;
+  }
+  int64_t size = -1;
+#ifdef __unix__
+  struct stat st;
+  if (fstat(fileno(fptr), &st) == 0) {
+    size = mem_map_file(mem, fileno(fptr), 0, st.st_size, start);
+  }
+#endif
+  if (size < 0) {
+    size = mem_copy_file(mem, fptr, start, UINT64_MAX);
+  }
+  fclose(fptr);
+  return size;
+}
+
+/**
+ * Zera [start, start + size), que precisa estar mapeado.
+ */
+void mem_zero(Memory *mem, uint32_t start, uint32_t size) {
+  while (size > 0) {
+    uint32_t room = PAGE_BYTES - (start & (PAGE_BYTES - 1));
+    if (room > size) {
+      room = size;
+    }
+    uint8_t *page = mem_write_ptr(mem, start & ~(PAGE_BYTES - 1));
+    if (page == NULL) {
+      return;
+    }
+    memset(page + (start & (PAGE_BYTES - 1)), 0, room);
+    start += room;
+    size -= room;
+  }
+}
+
+/**
+ * Copia n bytes da memória a partir de address para dst, um pedaço de página
+ * por vez. Devolve false se algum byte cai numa página não mapeada (falta).
+ */
+bool mem_read_bytes(Memory *mem, uint32_t address, void *dst, uint32_t n) {
+  uint8_t *out = (uint8_t *)dst;
+  while (n > 0) {
+    uint32_t room = PAGE_BYTES - (address & (PAGE_BYTES - 1));
+    if (room > n) {
+      room = n;
+    }
+    uint8_t *page = mem_read_ptr(mem, address & ~(PAGE_BYTES - 1));
+    if (page == NULL) {
+      return false;
+    }
+    memcpy(out, page + (address & (PAGE_BYTES - 1)), room);
+    out += room;
+    address += room;
+    n -= room;
+  }
+  return true;
+}
+
+/**
+ * Copia n bytes de src para a memória a partir de address, um pedaço de
+ * página por vez. Devolve false se algum byte cai numa página não mapeada
+ * (falta); os pedaços anteriores já foram escritos.
+ */
+bool mem_write_bytes(Memory *mem, uint32_t address, const void *src,
+                     uint32_t n) {
+  const uint8_t *in = (const uint8_t *)src;
+  while (n > 0) {
+    uint32_t room = PAGE_BYTES - (address & (PAGE_BYTES - 1));
+    if (room > n) {
+      room = n;
+    }
+    uint8_t *page = mem_write_ptr(mem, address & ~(PAGE_BYTES - 1));
+    if (page == NULL) {
+      return false;
+    }
+    memcpy(page + (address & (PAGE_BYTES - 1)), in, room);
+    in += room;
+    address += room;
+    n -= room;
+  }
+  return true;
+}
+
+/**
+ * Tamanho da string terminada em zero que começa em address, procurando o
+ * zero com memchr em cada página. Devolve -1 se a string chega numa página
+ * não mapeada (falta).
+ */
+int64_t mem_strlen(Memory *mem, uint32_t address) {
+  int64_t length = 0;
+  while (true) {
+    uint32_t offset = address & (PAGE_BYTES - 1);
+    uint8_t *page = mem_read_ptr(mem, address - offset);
+    if (page == NULL) {
+      return -1;
+    }
+    uint8_t *end = (uint8_t *)memchr(page + offset, 0, PAGE_BYTES - offset);
+    if (end != NULL) {
+      return length + (end - (page + offset));
+    }
+    length += PAGE_BYTES - offset;
+    address += PAGE_BYTES - offset;
+  }
+}
+
+/**
+ * Palavra das instruções atômicas (extensão A), já pronta para escrita e
+ * acessada com as operações atômicas do host. O endereço precisa ser múltiplo
+ * de 4; se não for escreve uma mensagem de erro e registra a falta, que para
+ * o hart na instrução atômica, e devolve NULL.
+ */
+int32_t *mem_atomic_word(Memory *mem, uint32_t address) {
+  if (address % 4 != 0) {
+    mem_report(mem, "Error in atomic access - address not multiple of 4!\n");
+    return (int32_t *)mem_fault(mem, address);
+  }
+  return (int32_t *)mem_write_ptr(mem, address);
+}
+
+// Loads e stores do programa. A memória guarda os bytes na ordem do RISC-V
+// (little-endian), a mesma do host, então cada acesso é uma leitura ou
+// escrita direta do tamanho certo (o memcpy de 1, 2 ou 4 bytes vira uma só
+// instrução do host) e a extensão de sinal fica com o tipo do resultado.
+// Acessos desalinhados são permitidos: dentro de uma página o host faz o
+// acesso desalinhado direto, e só o que cruza o fim de uma página vai para o
+// caminho lento, byte a byte. Em caso de falta a leitura devolve zero e a
+// escrita é descartada.
+
+/**
+ * Caminho lento dos acessos que cruzam o fim de uma página: lê size bytes a
+ * partir de address, um por vez, e os junta em little-endian. Devolve zero em
+ * caso de falta.
+ */
+uint32_t mem_load_split(Memory *mem, uint32_t address, uint32_t size) {
+  uint32_t value = 0;
+  for (uint32_t i = 0; i < size; i++) {
+    uint8_t *p = mem_read_ptr(mem, address + i);
+    if (p == NULL) {
+      return 0;
+    }
+    value |= (uint32_t)*p << 8 * i;
+  }
+  return value;
+}
+
+/**
+ * Caminho lento da escrita que cruza o fim de uma página. As duas páginas são
+ * conferidas antes, então uma falta não deixa a escrita pela metade.
+ */
+void mem_store_split(Memory *mem, uint32_t address, uint32_t value,
+                     uint32_t size) {
+  if (mem_write_ptr(mem, address) == NULL ||
+      mem_write_ptr(mem, (address | (PAGE_BYTES - 1)) + 1) == NULL) {
+    return;
+  }
+  for (uint32_t i = 0; i < size; i++) {
+    *mem_write_ptr(mem, address + i) = (uint8_t)(value >> 8 * i);
+  }
+}
+
+/**
+ * Lê size (1, 2 ou 4) bytes de address, com os bits que sobram zerados.
+ * Devolve zero em caso de falta.
+ */
+static inline uint32_t mem_load(Memory *mem, uint32_t address, uint32_t size) {
+  if ((address & (PAGE_BYTES - 1)) > PAGE_BYTES - size) {
+    return mem_load_split(mem, address, size);
+  }
+  uint8_t *p = mem_read_ptr(mem, address);
+  uint32_t value = 0;
+  if (p != NULL) {
+    memcpy(&value, p, size);
+  }
+  return value;
+}
+
+/**
+ * Escreve os size (1, 2 ou 4) bytes mais baixos de value em address. Em caso
+ * de falta nada é escrito.
+ */
+static inline void mem_store(Memory *mem, uint32_t address, uint32_t value,
+                             uint32_t size) {
+  if ((address & (PAGE_BYTES - 1)) > PAGE_BYTES - size) {
+    mem_store_split(mem, address, value, size);
+    return;
+  }
+  uint8_t *p = mem_write_ptr(mem, address);
+  if (p != NULL) {
+    memcpy(p, &value, size);
+  }
+}
+
+/**
+ * Lê o inteiro de 32 bits em address + kte.
+ */
+int32_t lw(Memory *mem, uint32_t address, int32_t kte) {
+  return mem_load(mem, address + kte, 4);
+}
+
+/**
+ * Lê o byte em address + kte, estendendo o sinal para 32 bits.
+ */
+int32_t lb(Memory *mem, uint32_t address, int32_t kte) {
+  return (int8_t)mem_load(mem, address + kte, 1);
+}
+
+/**
+ * Lê o byte em address + kte como um número positivo, com os bits superiores
+ * zerados.
+ */
+int32_t lbu(Memory *mem, uint32_t address, int32_t kte) {
+  return mem_load(mem, address + kte, 1);
+}
+
+/**
+ * Lê a meia palavra em address + kte, estendendo o sinal para 32 bits.
+ */
+int32_t lh(Memory *mem, uint32_t address, int32_t kte) {
+  return (int16_t)mem_load(mem, address + kte, 2);
+}
+
+/**
+ * Lê a meia palavra em address + kte como um número positivo, com os 16 bits
+ * superiores zerados.
+ */
+int32_t lhu(Memory *mem, uint32_t address, int32_t kte) {
+  return mem_load(mem, address + kte, 2);
+}
+
+/**
+ * Escreve o inteiro de 32 bits em address + kte.
+ */
+void sw(Memory *mem, uint32_t address, int32_t kte, int32_t dado) {
+  mem_store(mem, address + kte, dado, 4);
+}
+
+/**
+ * Escreve o byte em address + kte. Só ele muda, os vizinhos na mesma palavra
+ * não são lidos nem reescritos.
+ */
+void sb(Memory *mem, uint32_t address, int32_t kte, int8_t dado) {
+  mem_store(mem, address + kte, dado, 1);
+}
+
+/**
+ * Escreve a meia palavra em address + kte.
+ */
+void sh(Memory *mem, uint32_t address, int32_t kte, int16_t dado) {
+  mem_store(mem, address + kte, dado, 2);
+}
+/*
+int main() {
+  sb(0, 0, 0x04);
+  sb(0, 1, 0x03);
+  sb(0, 2, 0x02);
+  sb(0, 3, 0x01);
+
+  sb(4, 0, 0xFF);
+  sb(4, 2, 0xFD);
+  sb(4, 3, 0xFC);
+
+  sw(12, 0, 0xFF);
+  sw(16, 0, 0xFFFF);
+  sw(20, 0, 0xFFFFFFFF);
+  sw(24, 0, 0x80000000);
+
+  printf("mem[0] = %08x\n", mem[0]);
+  printf("mem[1] = %08x\n", mem[1]);
+  printf("mem[2] = %08x\n", mem[2]);
+  printf("mem[3] = %08x\n", mem[3]);
+  printf("mem[4] = %08x\n", mem[4]);
+  printf("mem[5] = %08x\n", mem[5]);
+  printf("mem[6] = %08x\n", mem[6]);
+
+  printf("lb(4,0) = %08x\n", lb(4, 0));
+  printf("lb(4,1) = %08x\n", lb(4, 1));
+  printf("lb(4,2) = %08x\n", lb(4, 2));
+  printf("lb(4,3) = %08x\n", lb(4, 3));
+  printf("lbu(4,0) = %08x\n", lbu(4, 0));
+  printf("lbu(4,1) = %08x\n", lbu(4, 1));
+  printf("lbu(4,2) = %08x\n", lbu(4, 2));
+  printf("lbu(4,3) = %08x\n", lbu(4, 3));
+  printf("lw(12,0) = %08x\n", lw(12, 0));
+  printf("lw(16,0) = %08x\n", lw(16, 0));
+  printf("lw(20,0) = %08x\n", lw(20, 0));
+
+  return 0;
+}
 */
\ No newline at end of file
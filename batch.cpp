@@ -0,0 +1,246 @@
+/*
+ *  batch.cpp
+ *
+ * Modo batch: roda uma lista de programas (manifesto), cada um no seu proprio
+ * Hart, distribuidos entre threads. Cada thread tem a sua fila de programas e,
+ * quando ela esvazia, rouba programas do fim da fila de outra thread.
+ *
+ * Formato do manifesto, uma linha por programa (linhas com # sao ignoradas):
+ *   <code.bin> <data.bin> [arquivo de resultado]
+ *   <programa.elf> [arquivo de resultado]
+ *   <estado.snap> [arquivo de resultado]
+ * O resultado padrao e <code.bin>.result (ou <programa.elf>.result).
+ *
+ * Um snapshot (ver snapshot.cpp) e lido uma vez so, e todas as linhas dele
+ * restauram harts que dividem as paginas. A n-esima linha de um mesmo
+ * snapshot e a variante n (0, 1, ...), que volta do ecall de snapshot em a0;
+ * o resultado padrao dela e <estado.snap>.<n>.result.
+ */
+
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// Roda o programa ja carregado no hart com o motor escolhido. Com o perfil,
+// o trace ou um modelo de tempo ligado roda sempre o motor de referencia.
+//
+void run_engine(Hart &h, ENGINES engine) {
+  if (h.profile != nullptr) {
+    h.run_profiled();
+    return;
+  }
+  if (h.trace != nullptr) {
+    h.run_traced();
+    return;
+  }
+  if (h.pipeline != nullptr) {
+    h.run_pipelined();
+    return;
+  }
+  if (h.cache != nullptr) {
+    h.run_cached();
+    return;
+  }
+  switch (engine) {
+    case E_SWITCH:
+      h.run();
+      break;
+    case E_THREADED:
+      h.run_threaded();
+      break;
+    case E_JIT:
+      h.run_jit();
+      break;
+  }
+}
+
+// Um programa do manifesto e o que sobrou da execucao dele
+//
+struct BatchJob {
+  string code, data, result;  // data vazio: code e um ELF ou um snapshot
+  shared_ptr<const Snapshot> snapshot;  // nulo se code nao e um snapshot
+  int32_t variant;                      // variante restaurada do snapshot
+  uint64_t instret;
+};
+
+// Fila de programas de uma thread. A dona tira do inicio, as outras roubam
+// do fim.
+//
+class WorkQueue {
+ public:
+  void push(size_t job) {
+    lock_guard<mutex> lock(m);
+    jobs.push_back(job);
+  }
+
+  bool pop(size_t &job) {
+    lock_guard<mutex> lock(m);
+    if (jobs.empty()) {
+      return false;
+    }
+    job = jobs.front();
+    jobs.pop_front();
+    return true;
+  }
+
+  bool steal(size_t &job) {
+    lock_guard<mutex> lock(m);
+    if (jobs.empty()) {
+      return false;
+    }
+    job = jobs.back();
+    jobs.pop_back();
+    return true;
+  }
+
+ private:
+  mutex m;
+  deque<size_t> jobs;
+};
+
+// Le o manifesto. Devolve false se o arquivo nao abrir.
+//
+bool read_manifest(const char *fn, vector<BatchJob> &jobs) {
+  ifstream in(fn);
+  if (!in) {
+    return false;
+  }
+  map<string, shared_ptr<const Snapshot>> snapshots;
+  map<string, int32_t> variants;
+  string line;
+  while (getline(in, line)) {
+    istringstream fields(line);
+    BatchJob job;
+    if (!(fields >> job.code) || job.code[0] == '#') {
+      continue;
+    }
+    job.variant = 0;
+    if (is_snapshot(job.code.c_str())) {
+      if (snapshots.count(job.code) == 0) {
+        snapshots[job.code] = load_snapshot(job.code.c_str());
+      }
+      job.snapshot = snapshots[job.code];
+      if (job.snapshot == nullptr) {
+        printf("Manifesto: snapshot invalido %s\n", job.code.c_str());
+        continue;
+      }
+      job.variant = variants[job.code]++;
+    } else if (!is_elf(job.code.c_str()) && !(fields >> job.data)) {
+      printf("Manifesto: falta o data.bin de %s\n", job.code.c_str());
+      continue;
+    }
+    if (!(fields >> job.result)) {
+      job.result = job.code + ".result";
+      if (job.snapshot != nullptr) {
+        job.result = job.code + "." + to_string(job.variant) + ".result";
+      }
+    }
+    job.instret = 0;
+    jobs.push_back(job);
+  }
+  return true;
+}
+
+// Roda um programa num hart novo e escreve o arquivo de resultado
+//
+void run_job(BatchJob &job, ENGINES engine, uint64_t limit) {
+  Hart *h = new Hart();
+  string console;
+  h->console.capture = &console;
+  h->console.in = nullptr;
+  h->instret_limit = limit;
+  bool loaded = true;
+  if (job.snapshot != nullptr) {
+    h->restore(job.snapshot, job.variant);
+  } else if (job.data.empty()) {
+    loaded = h->load_elf(job.code.c_str());
+  } else {
+    loaded = h->load_mem(job.code.c_str(), 0) >= 0 &&
+             h->load_mem(job.data.c_str(), DATA_SEGMENT_START) >= 0;
+  }
+  if (!loaded) {
+    console = "Erro ao carregar o programa\n";
+  } else {
+    run_engine(*h, engine);
+  }
+  job.instret = h->instret;
+
+  FILE *out = fopen(job.result.c_str(), "w");
+  if (out == nullptr) {
+    printf("Nao foi possivel escrever %s\n", job.result.c_str());
+  } else {
+    fprintf(out, "programa: %s %s\n", job.code.c_str(), job.data.c_str());
+    if (job.snapshot != nullptr) {
+      fprintf(out, "variante: %d\n", job.variant);
+    }
+    fprintf(out, "fim: %s (%d)\n", exit_str[h->exit_reason], h->exit_code);
+    fprintf(out, "instrucoes: %llu\n", (unsigned long long)h->instret);
+    fprintf(out, "--- saida ---\n%s\n", console.c_str());
+    fprintf(out, "--- registradores ---\n");
+    h->dump_breg(out);
+    fclose(out);
+  }
+  delete h;
+}
+
+// Roda todos os programas do manifesto. threads = 0 usa um por nucleo.
+// Imprime o total de instrucoes e o MIPS agregado.
+//
+int run_batch(const char *manifest, unsigned threads, ENGINES engine,
+              uint64_t limit) {
+  vector<BatchJob> jobs;
+  if (!read_manifest(manifest, jobs)) {
+    printf("Manifesto nao encontrado: %s\n", manifest);
+    return -1;
+  }
+  if (threads == 0) {
+    threads = thread::hardware_concurrency();
+  }
+  if (threads == 0) {
+    threads = 1;
+  }
+  if (threads > jobs.size() && !jobs.empty()) {
+    threads = jobs.size();
+  }
+
+  vector<WorkQueue> queues(threads);
+  for (size_t i = 0; i < jobs.size(); i++) {
+    queues[i % threads].push(i);
+  }
+
+  auto start = chrono::steady_clock::now();
+  vector<thread> workers;
+  for (unsigned t = 0; t < threads; t++) {
+    workers.emplace_back([&, t] {
+      size_t job;
+      while (true) {
+        bool found = queues[t].pop(job);
+        for (unsigned v = 1; !found && v < threads; v++) {
+          found = queues[(t + v) % threads].steal(job);
+        }
+        if (!found) {
+          return;  // ninguem mais tem trabalho
+        }
+        run_job(jobs[job], engine, limit);
+      }
+    });
+  }
+  for (thread &w : workers) {
+    w.join();
+  }
+  double seconds =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  uint64_t total = 0;
+  for (const BatchJob &job : jobs) {
+    total += job.instret;
+  }
+  printf("%zu programas, %u threads, %llu instrucoes em %.3f s (%.1f MIPS)\n",
+         jobs.size(), threads, (unsigned long long)total, seconds,
+         seconds > 0 ? total / seconds / 1e6 : 0.0);
+  return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ *  bench.cpp
+ *
+ * Benchmark do nucleo do interpretador. Roda cada kernel da lista (ver
+ * bench/kernels.txt) no motor escolhido: primeiro algumas vezes sem medir
+ * (aquecimento), depois as iteracoes medidas. Cada execucao usa um Hart novo
+ * com o programa recarregado, entao todas fazem exatamente o mesmo trabalho,
+ * e so a execucao e cronometrada (o carregamento fica de fora).
+ *
+ * Para cada kernel imprime as instrucoes executadas, o tempo mediano e o
+ * melhor, os MIPS e ns por instrucao da mediana e o pico de RSS do processo
+ * ate o fim do kernel. No fim imprime a media geometrica dos MIPS.
+ *
+ * Formato da lista: um kernel por linha (linhas com # sao ignoradas). O
+ * kernel <nome> usa <nome>.code.bin e <nome>.data.bin do diretorio da lista.
+ */
+
+#include <cmath>
+#ifdef __unix__
+#include <sys/resource.h>
+#endif
+
+// Pico de memoria residente do processo em KiB, 0 se nao disponivel
+//
+long peak_rss_kb() {
+#ifdef __unix__
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    return usage.ru_maxrss;
+  }
+#endif
+  return 0;
+}
+
+// Roda o kernel uma vez num hart novo. Devolve o tempo de execucao em
+// segundos, ou -1 se o programa nao carregou ou nao terminou com o ecall de
+// saida.
+//
+double bench_once(const string &code, const string &data, ENGINES engine,
+                  uint64_t &instret) {
+  Hart *h = new Hart();
+  string console;
+  h->console.capture = &console;
+  h->console.in = nullptr;
+  double seconds = -1;
+  if (h->load_mem(code.c_str(), 0) >= 0 &&
+      h->load_mem(data.c_str(), DATA_SEGMENT_START) >= 0) {
+    auto start = chrono::steady_clock::now();
+    run_engine(*h, engine);
+    seconds =
+        chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    instret = h->instret;
+    if (h->exit_reason != EXIT_ECALL) {
+      printf("%s terminou com %s\n", code.c_str(), exit_str[h->exit_reason]);
+      seconds = -1;
+    }
+  }
+  delete h;
+  return seconds;
+}
+
+// Roda todos os kernels da lista. Devolve -1 se a lista nao abrir ou algum
+// kernel falhar.
+//
+int run_bench(const char *list, ENGINES engine, int warmup, int iterations) {
+  ifstream in(list);
+  if (!in) {
+    printf("Lista de kernels nao encontrada: %s\n", list);
+    return -1;
+  }
+  string dir = list;
+  size_t slash = dir.find_last_of('/');
+  dir = slash == string::npos ? "" : dir.substr(0, slash + 1);
+  if (iterations < 1) {
+    iterations = 1;
+  }
+
+  printf("%d aquecimento(s), %d iteracao(oes) por kernel\n", warmup,
+         iterations);
+  printf("%-10s %12s %10s %10s %9s %9s %10s\n", "kernel", "instrucoes",
+         "mediana s", "melhor s", "MIPS", "ns/instr", "RSS KiB");
+  int status = 0;
+  int kernels = 0;
+  double log_mips = 0;
+  string line;
+  while (getline(in, line)) {
+    istringstream fields(line);
+    string name;
+    if (!(fields >> name) || name[0] == '#') {
+      continue;
+    }
+    string code = dir + name + ".code.bin";
+    string data = dir + name + ".data.bin";
+    uint64_t instret = 0;
+    bool failed = false;
+    for (int i = 0; i < warmup && !failed; i++) {
+      failed = bench_once(code, data, engine, instret) < 0;
+    }
+    vector<double> times;
+    for (int i = 0; i < iterations && !failed; i++) {
+      double seconds = bench_once(code, data, engine, instret);
+      failed = seconds < 0;
+      times.push_back(seconds);
+    }
+    if (failed) {
+      printf("%-10s falhou\n", name.c_str());
+      status = -1;
+      continue;
+    }
+    sort(times.begin(), times.end());
+    double median = times[times.size() / 2];
+    if (times.size() % 2 == 0) {
+      median = (median + times[times.size() / 2 - 1]) / 2;
+    }
+    double mips = median > 0 ? instret / median / 1e6 : 0.0;
+    printf("%-10s %12llu %10.4f %10.4f %9.1f %9.2f %10ld\n", name.c_str(),
+           (unsigned long long)instret, median, times[0], mips,
+           instret > 0 ? median * 1e9 / instret : 0.0, peak_rss_kb());
+    if (mips > 0) {
+      log_mips += log(mips);
+      kernels++;
+    }
+  }
+  if (kernels > 0) {
+    printf("media geometrica: %.1f MIPS\n", exp(log_mips / kernels));
+  }
+  return status;
+}
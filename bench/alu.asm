@@ -0,0 +1,21 @@
+# kernel de ALU: laco apertado de operacoes logico-aritmeticas, sem memoria
+# 9 instrucoes por iteracao, 2.5M iteracoes
+
+.text
+	li s0, 2500000
+	li a0, 0
+	li a1, 1
+loop:
+	add a0, a0, a1
+	xor a2, a0, s0
+	slli a3, a2, 3
+	srli a4, a3, 1
+	or a1, a4, a1
+	andi a1, a1, 255
+	addi a1, a1, 1
+	addi s0, s0, -1
+	bne s0, zero, loop
+	li a7, 1
+	ecall			# imprime a soma
+	li a7, 10
+	ecall
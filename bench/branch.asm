@@ -0,0 +1,39 @@
+# kernel de desvios: xorshift32 decide desvios dependentes de dados
+# cerca de 20 instrucoes por iteracao, 1M iteracoes
+
+.text
+	li s0, 1000000
+	li s1, 2463534242	# semente do xorshift
+	li s2, 0		# impares
+	li s3, 0		# abaixo do limiar
+	li s4, 0		# multiplos de 8
+	li s5, 0x40000000	# limiar
+loop:
+	slli t0, s1, 13
+	xor s1, s1, t0
+	srli t0, s1, 17
+	xor s1, s1, t0
+	slli t0, s1, 5
+	xor s1, s1, t0
+	andi t1, s1, 1
+	beq t1, zero, par
+	addi s2, s2, 1
+par:
+	bgeu s1, s5, alto
+	addi s3, s3, 1
+alto:
+	andi t1, s1, 7
+	bne t1, zero, next
+	addi s4, s4, 1
+next:
+	blt s1, zero, negativo
+	addi s2, s2, 2
+negativo:
+	addi s0, s0, -1
+	bne s0, zero, loop
+	add a0, s2, s3
+	add a0, a0, s4
+	li a7, 1
+	ecall			# imprime a soma dos contadores
+	li a7, 10
+	ecall
@@ -0,0 +1,44 @@
+# kernel bytes: copia 2 KiB byte a byte com lbu/sb e soma as meias palavras
+# com lh, para os acessos menores que uma palavra
+# 11 instrucoes por 4 bytes, 6000 copias
+
+.data
+origem:	.space 2048
+destino: .space 2048
+
+.text
+	la t0, origem		# preenche a origem com 0, 1, 2, ... (mod 256)
+	li t1, 0
+	li t2, 2048
+preenche:
+	sb t1, 0(t0)
+	addi t0, t0, 1
+	addi t1, t1, 1
+	bne t1, t2, preenche
+	li s0, 6000
+copia:
+	la a0, destino
+	la a1, origem
+	li a2, 512
+	li s1, 0
+bloco:
+	lbu t0, 0(a1)
+	lbu t1, 1(a1)
+	sb t0, 0(a0)
+	sb t1, 1(a0)
+	lh t2, 2(a1)
+	sh t2, 2(a0)
+	add s1, s1, t2
+	addi a1, a1, 4
+	addi a0, a0, 4
+	addi a2, a2, -1
+	bne a2, zero, bloco
+	addi s0, s0, -1
+	bne s0, zero, copia
+	la t0, destino
+	lb a0, 2047(t0)
+	add a0, a0, s1
+	li a7, 1
+	ecall			# imprime 196607
+	li a7, 10
+	ecall
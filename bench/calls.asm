@@ -0,0 +1,28 @@
+# kernel de chamadas: fibonacci recursivo com JAL/JALR e pilha
+# fib(29), cerca de 1.7M chamadas
+
+.text
+	li a0, 29
+	jal fib
+	li a7, 1
+	ecall			# imprime 514229
+	li a7, 10
+	ecall
+fib:
+	li t0, 2
+	blt a0, t0, base
+	addi sp, sp, -12
+	sw ra, 0(sp)
+	sw a0, 4(sp)
+	addi a0, a0, -1
+	jal fib
+	sw a0, 8(sp)
+	lw a0, 4(sp)
+	addi a0, a0, -2
+	jal fib
+	lw t1, 8(sp)
+	add a0, a0, t1
+	lw ra, 0(sp)
+	addi sp, sp, 12
+base:
+	ret
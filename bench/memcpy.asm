@@ -0,0 +1,42 @@
+# kernel memcpy: copia 2 KiB palavra a palavra, desenrolado em 4
+# 11 instrucoes por 4 palavras, 15000 copias
+
+.data
+origem:	.space 2048
+destino: .space 2048
+
+.text
+	la t0, origem		# preenche a origem com 0, 1, 2, ...
+	li t1, 0
+	li t2, 512
+preenche:
+	sw t1, 0(t0)
+	addi t0, t0, 4
+	addi t1, t1, 1
+	bne t1, t2, preenche
+	li s0, 15000
+copia:
+	la a0, destino
+	la a1, origem
+	li a2, 128
+bloco:
+	lw t0, 0(a1)
+	lw t1, 4(a1)
+	lw t2, 8(a1)
+	lw t3, 12(a1)
+	sw t0, 0(a0)
+	sw t1, 4(a0)
+	sw t2, 8(a0)
+	sw t3, 12(a0)
+	addi a1, a1, 16
+	addi a0, a0, 16
+	addi a2, a2, -1
+	bne a2, zero, bloco
+	addi s0, s0, -1
+	bne s0, zero, copia
+	la t0, destino
+	lw a0, 2044(t0)
+	li a7, 1
+	ecall			# imprime 511
+	li a7, 10
+	ecall
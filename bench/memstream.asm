@@ -0,0 +1,26 @@
+# kernel de memoria: percorre um vetor de 1K palavras lendo e escrevendo
+# 7 instrucoes por palavra, 3000 passadas
+
+.data
+vetor:	.space 4096
+
+.text
+	li s0, 3000
+	li a0, 0
+passada:
+	la t0, vetor
+	li t1, 1024
+palavra:
+	lw t2, 0(t0)
+	add a0, a0, t2
+	addi a0, a0, 1
+	sw a0, 0(t0)
+	addi t0, t0, 4
+	addi t1, t1, -1
+	bne t1, zero, palavra
+	addi s0, s0, -1
+	bne s0, zero, passada
+	li a7, 1
+	ecall			# imprime o acumulador
+	li a7, 10
+	ecall
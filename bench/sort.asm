@@ -0,0 +1,58 @@
+# kernel de ordenacao: insertion sort de 512 palavras aleatorias (xorshift32)
+# repetido 40 vezes, cada vez com numeros novos
+
+.data
+vetor:	.space 2048
+
+.text
+	li s1, 2463534242	# semente do xorshift
+	li s5, 40
+rodada:
+	la t0, vetor
+	li t1, 512
+preenche:
+	slli t2, s1, 13
+	xor s1, s1, t2
+	srli t2, s1, 17
+	xor s1, s1, t2
+	slli t2, s1, 5
+	xor s1, s1, t2
+	sw s1, 0(t0)
+	addi t0, t0, 4
+	addi t1, t1, -1
+	bne t1, zero, preenche
+	la s2, vetor
+	li t0, 2048
+	add s4, s2, t0		# fim do vetor
+	addi s3, s2, 4		# &vetor[i]
+externo:
+	lw t1, 0(s3)		# chave
+	mv t2, s3
+interno:
+	beq t2, s2, insere
+	lw t3, -4(t2)
+	bge t1, t3, insere
+	sw t3, 0(t2)
+	addi t2, t2, -4
+	j interno
+insere:
+	sw t1, 0(t2)
+	addi s3, s3, 4
+	bne s3, s4, externo
+	addi s5, s5, -1
+	bne s5, zero, rodada
+	la t0, vetor		# confere a ordem: conta as inversoes
+	addi t4, t0, 2044
+	li a0, 0
+confere:
+	lw t1, 0(t0)
+	lw t2, 4(t0)
+	bge t2, t1, ok
+	addi a0, a0, 1
+ok:
+	addi t0, t0, 4
+	bne t0, t4, confere
+	li a7, 1
+	ecall			# imprime 0
+	li a7, 10
+	ecall
@@ -0,0 +1,363 @@
+/*
+ *  cache.cpp
+ *
+ * Modelo de tempo da hierarquia de memoria: caches L1 de instrucoes (l1i),
+ * L1 de dados (l1d) e uma L2 unificada (l2), todas opcionais, e a memoria
+ * principal. Cada busca de instrucao passa pela l1i e cada load/store pela
+ * l1d; as faltas descem para a l2 e dela para a memoria. No fim sao
+ * impressos os acessos, as faltas e os writebacks de cada nivel e o total
+ * estimado de ciclos, em que cada acesso custa a latencia de cada nivel que
+ * ele visitou (sem buffer de escrita: writebacks e escritas write-through
+ * tambem pagam a latencia do nivel de baixo).
+ *
+ * O modelo so olha os enderecos, nao guarda dados: a memoria do hart continua
+ * sendo a unica fonte dos valores. Ele tem o seu proprio laco
+ * (Hart::run_cached), que calcula o endereco de cada load/store a partir da
+ * instrucao decodificada, entao os motores e os acessos de acessoMemoriaRV.c
+ * nao pagam nada quando ele esta desligado. As copias em bloco dos ecalls
+ * (read/write de arquivos) nao passam pelo modelo.
+ *
+ * Cada nivel guarda so as tags, uma palavra de 32 bits por linha (o numero da
+ * linha, valida e suja nos 2 bits de baixo), com as vias de um conjunto
+ * contiguas: um conjunto de 8 vias ocupa 32 bytes da cache do host. A ordem
+ * das vias e a da politica de troca: no LRU a via usada vai para a frente, no
+ * FIFO so a linha nova entra na frente, e nos dois a vitima e a ultima; no
+ * random a vitima e sorteada e a ordem nao importa.
+ *
+ * Configuracao (main.exe -m), niveis separados por virgula:
+ *   nome=tamanho:vias:linha:latencia[:lru|fifo|random][:wb|wt]
+ *   mem=latencia
+ * com nome l1i, l1d ou l2 e tamanho em bytes (aceita k e m). wb e
+ * write-back com write-allocate (o padrao), wt e write-through sem
+ * write-allocate. "padrao" usa CACHE_DEFAULT.
+ */
+
+#include <sstream>
+
+const char CACHE_DEFAULT[] =
+    "l1i=32k:8:64:1,l1d=32k:8:64:1,l2=256k:8:64:10,mem=100";
+
+enum CACHE_LEVELS { C_L1I, C_L1D, C_L2, C_LEVELS };
+enum CACHE_POLICIES { C_LRU, C_FIFO, C_RANDOM };
+
+const char *const cache_names[C_LEVELS] = {"l1i", "l1d", "l2"};
+
+// Bits de baixo de cada tag
+enum : uint32_t { CACHE_VALID = 1, CACHE_DIRTY = 2 };
+
+struct CacheLevel {
+  bool present;
+  uint32_t size, ways, line, latency;
+  CACHE_POLICIES policy;
+  bool write_back;
+  uint32_t offset_bits;  // log2 da linha
+  uint32_t set_mask;     // conjuntos - 1
+  int next;              // nivel de baixo, -1 para a memoria
+  vector<uint32_t> tags;  // conjuntos x vias
+  uint64_t accesses, misses, writebacks;
+};
+
+struct CacheModel {
+  CacheLevel levels[C_LEVELS];
+  uint32_t memory_latency;
+  uint64_t memory_accesses;
+  uint64_t cycles;  // total estimado
+  uint32_t seed;    // sorteio das vitimas do random
+};
+
+/******************************* CONFIGURACAO ********************************/
+
+// Le um numero com sufixo k ou m opcional. Devolve false se nao for um.
+//
+bool cache_number(const string &text, uint32_t &value) {
+  char *end;
+  unsigned long n = strtoul(text.c_str(), &end, 10);
+  if (end == text.c_str()) {
+    return false;
+  }
+  if (*end == 'k' || *end == 'K') {
+    n <<= 10;
+    end++;
+  } else if (*end == 'm' || *end == 'M') {
+    n <<= 20;
+    end++;
+  }
+  value = n;
+  return *end == '\0' && n == value;
+}
+
+bool power_of_two(uint32_t n) { return n != 0 && (n & (n - 1)) == 0; }
+
+// Le a configuracao de um nivel (tamanho:vias:linha:latencia[:...])
+//
+bool cache_parse_level(CacheLevel &c, const string &text) {
+  vector<string> fields;
+  istringstream in(text);
+  string field;
+  while (getline(in, field, ':')) {
+    fields.push_back(field);
+  }
+  if (fields.size() < 4 || !cache_number(fields[0], c.size) ||
+      !cache_number(fields[1], c.ways) || !cache_number(fields[2], c.line) ||
+      !cache_number(fields[3], c.latency)) {
+    return false;
+  }
+  c.policy = C_LRU;
+  c.write_back = true;
+  for (size_t i = 4; i < fields.size(); i++) {
+    if (fields[i] == "lru") {
+      c.policy = C_LRU;
+    } else if (fields[i] == "fifo") {
+      c.policy = C_FIFO;
+    } else if (fields[i] == "random") {
+      c.policy = C_RANDOM;
+    } else if (fields[i] == "wb") {
+      c.write_back = true;
+    } else if (fields[i] == "wt") {
+      c.write_back = false;
+    } else {
+      return false;
+    }
+  }
+  // linha de pelo menos 4 bytes: o numero da linha cabe em 30 bits
+  if (!power_of_two(c.line) || c.line < 4 || c.ways == 0 ||
+      c.size % (c.ways * c.line) != 0 ||
+      !power_of_two(c.size / (c.ways * c.line))) {
+    return false;
+  }
+  c.present = true;
+  c.offset_bits = 0;
+  while ((1u << c.offset_bits) < c.line) {
+    c.offset_bits++;
+  }
+  c.set_mask = c.size / (c.ways * c.line) - 1;
+  c.tags.assign(c.size / c.line, 0);
+  return true;
+}
+
+// Cria o modelo a partir da configuracao (ver o comeco do arquivo). Devolve
+// nulo, com a mensagem impressa, se ela for invalida.
+//
+CacheModel *cache_new(const char *spec) {
+  if (strcmp(spec, "padrao") == 0) {
+    spec = CACHE_DEFAULT;
+  }
+  CacheModel *m = new CacheModel;
+  for (CacheLevel &c : m->levels) {
+    c.present = false;
+    c.accesses = c.misses = c.writebacks = 0;
+  }
+  m->memory_latency = 100;
+  m->memory_accesses = 0;
+  m->cycles = 0;
+  m->seed = 0x2545F491;
+
+  istringstream in(spec);
+  string item;
+  while (getline(in, item, ',')) {
+    size_t equal = item.find('=');
+    string name = item.substr(0, equal);
+    string value = equal == string::npos ? "" : item.substr(equal + 1);
+    bool ok = false;
+    if (name == "mem") {
+      ok = cache_number(value, m->memory_latency);
+    }
+    for (int i = 0; i < C_LEVELS; i++) {
+      if (name == cache_names[i]) {
+        ok = cache_parse_level(m->levels[i], value);
+      }
+    }
+    if (!ok) {
+      printf("Configuracao de cache invalida: %s\n", item.c_str());
+      delete m;
+      return nullptr;
+    }
+  }
+  int below = m->levels[C_L2].present ? C_L2 : -1;
+  m->levels[C_L1I].next = below;
+  m->levels[C_L1D].next = below;
+  m->levels[C_L2].next = -1;
+  return m;
+}
+
+void cache_release(CacheModel *m) { delete m; }
+
+// Esvazia as caches e zera os contadores
+//
+void cache_reset(CacheModel &m) {
+  for (CacheLevel &c : m.levels) {
+    fill(c.tags.begin(), c.tags.end(), 0);
+    c.accesses = c.misses = c.writebacks = 0;
+  }
+  m.memory_accesses = 0;
+  m.cycles = 0;
+}
+
+/********************************** ACESSO ***********************************/
+
+// Acessa a linha de address no nivel level (-1 e a memoria). Devolve os
+// ciclos gastos neste nivel e nos de baixo.
+//
+uint32_t cache_access(CacheModel &m, int level, uint32_t address, bool write) {
+  if (level < 0) {
+    m.memory_accesses++;
+    return m.memory_latency;
+  }
+  CacheLevel &c = m.levels[level];
+  c.accesses++;
+  uint32_t cycles = c.latency;
+  uint32_t line = address >> c.offset_bits;
+  uint32_t tag = line << 2 | CACHE_VALID;
+  uint32_t *set = &c.tags[(line & c.set_mask) * c.ways];
+
+  for (uint32_t i = 0; i < c.ways; i++) {
+    if ((set[i] & ~CACHE_DIRTY) != tag) {
+      continue;
+    }
+    uint32_t hit = set[i];
+    if (write && c.write_back) {
+      hit |= CACHE_DIRTY;
+    } else if (write) {
+      cycles += cache_access(m, c.next, address, true);
+    }
+    if (c.policy == C_LRU && i > 0) {
+      memmove(set + 1, set, i * sizeof(uint32_t));
+      i = 0;
+    }
+    set[i] = hit;
+    return cycles;
+  }
+
+  c.misses++;
+  if (write && !c.write_back) {
+    return cycles + cache_access(m, c.next, address, true);  // sem allocate
+  }
+  cycles += cache_access(m, c.next, address, false);
+  uint32_t victim = c.ways - 1;
+  if (c.policy == C_RANDOM) {
+    m.seed ^= m.seed << 13;
+    m.seed ^= m.seed >> 17;
+    m.seed ^= m.seed << 5;
+    victim = m.seed % c.ways;
+  }
+  if ((set[victim] & (CACHE_VALID | CACHE_DIRTY)) ==
+      (CACHE_VALID | CACHE_DIRTY)) {
+    c.writebacks++;
+    cycles += cache_access(m, c.next, (set[victim] >> 2) << c.offset_bits,
+                           true);
+  }
+  if (c.policy != C_RANDOM) {
+    memmove(set + 1, set, victim * sizeof(uint32_t));
+    victim = 0;
+  }
+  set[victim] = write ? tag | CACHE_DIRTY : tag;
+  return cycles;
+}
+
+// Acesso de size bytes em address, que pode cruzar duas linhas. Devolve os
+// ciclos gastos, que tambem entram no total.
+//
+uint32_t cache_touch(CacheModel &m, int level, uint32_t address, uint32_t size,
+                     bool write) {
+  // sem o nivel (l1i ou l1d ausente) o acesso vai direto para o de baixo
+  if (!m.levels[level].present) {
+    level = m.levels[level].next;
+  }
+  uint32_t cycles = cache_access(m, level, address, write);
+  uint32_t offset_bits = level < 0 ? 2 : m.levels[level].offset_bits;
+  uint32_t last = address + size - 1;
+  if ((last >> offset_bits) != (address >> offset_bits)) {
+    cycles += cache_access(m, level, last, write);
+  }
+  m.cycles += cycles;
+  return cycles;
+}
+
+// Acesso a dados da instrucao executada, com o endereco efetivo. Devolve os
+// ciclos gastos, 0 se ela nao acessa a memoria.
+//
+uint32_t cache_data(CacheModel &m, INSTRUCTIONS instruction,
+                    uint32_t address) {
+  switch (instruction) {
+    case I_lb:
+    case I_lbu:
+      return cache_touch(m, C_L1D, address, 1, false);
+    case I_lh:
+    case I_lhu:
+      return cache_touch(m, C_L1D, address, 2, false);
+    case I_lw:
+    case I_lr_w:
+      return cache_touch(m, C_L1D, address, 4, false);
+    case I_sb:
+      return cache_touch(m, C_L1D, address, 1, true);
+    case I_sh:
+      return cache_touch(m, C_L1D, address, 2, true);
+    case I_sw:
+    case I_sc_w:
+    case I_amoswap_w:
+    case I_amoadd_w:
+    case I_amoxor_w:
+    case I_amoand_w:
+    case I_amoor_w:
+    case I_amomin_w:
+    case I_amomax_w:
+    case I_amominu_w:
+    case I_amomaxu_w:
+      return cache_touch(m, C_L1D, address, 4, true);
+    default:
+      return 0;
+  }
+}
+
+/********************************* RELATORIO *********************************/
+
+// Imprime os contadores de cada nivel e os ciclos estimados
+//
+void cache_report(CacheModel &m, uint64_t instret) {
+  printf("%-5s %10s %7s %6s %12s %12s %8s %10s\n", "cache", "tamanho",
+         "vias", "linha", "acessos", "faltas", "taxa", "writebacks");
+  for (int i = 0; i < C_LEVELS; i++) {
+    const CacheLevel &c = m.levels[i];
+    if (!c.present) {
+      continue;
+    }
+    printf("%-5s %10u %7u %6u %12llu %12llu %7.2f%% %10llu\n", cache_names[i],
+           c.size, c.ways, c.line, (unsigned long long)c.accesses,
+           (unsigned long long)c.misses,
+           c.accesses > 0 ? 100.0 * c.misses / c.accesses : 0.0,
+           (unsigned long long)c.writebacks);
+  }
+  printf("memoria: %llu acessos\n", (unsigned long long)m.memory_accesses);
+  printf("ciclos estimados: %llu (CPI %.2f)\n", (unsigned long long)m.cycles,
+         instret > 0 ? (double)m.cycles / instret : 0.0);
+}
+
+/********************************** ENGINE ***********************************/
+
+// Motor de referencia com o modelo de cache. O endereco dos loads/stores e
+// calculado antes do execute, que pode mudar rs1.
+//
+void Hart::run_cached() {
+  init();
+  clear_decoded();
+  cache_reset(*cache);
+  while (running()) {
+    uint32_t at = pc;
+    instret++;
+    fetch_decoded();
+    if (mem.fault) {
+      break;
+    }
+    uint32_t size = ilen;
+    uint32_t address = breg[rs1] + imm32_t;
+    INSTRUCTIONS executed = instruction;
+    retire();
+    if (mem.fault) {
+      break;
+    }
+    cache_touch(*cache, C_L1I, at, size, false);
+    cache_data(*cache, executed, address);
+  }
+  report_finish();
+  cache_report(*cache, instret);
+}
@@ -0,0 +1,114 @@
+//
+//  console.h
+//  RV32Ic++
+//
+//  Saida dos ecalls de um hart. O texto vai para um buffer proprio de cada
+//  hart e so e escrito no destino quando passa do limite, quando o
+//  programa termina (Hart::report_finish) ou quando flush() e chamado. O
+//  destino e um FILE* (stdout por padrao) ou, no modo captura usado pelo
+//  batch, uma string em memoria. Assim programas que imprimem em laco nao
+//  pagam um printf por ecall, e a saida de harts concorrentes nao se mistura.
+//  A entrada dos ecalls de leitura tambem passa por aqui: antes de ler, a
+//  saida e esvaziada para o prompt aparecer.
+//
+
+#ifndef __CONSOLE_H__
+#define __CONSOLE_H__
+
+class Console {
+ public:
+  enum { CAPACITY = 8192 };   // tamanho do buffer
+  enum { THRESHOLD = 4096 };  // esvazia o buffer quando passa disto
+
+  FILE *out;        // destino quando capture e nulo
+  string *capture;  // se nao for nulo, a saida e guardada aqui
+  FILE *in;         // entrada; se for nula o programa le fim de arquivo
+
+  Console() : out(stdout), capture(nullptr), in(stdin), used(0) {}
+  ~Console() { flush(); }
+
+  void put(const char *text, size_t n) {
+    if (used + n > CAPACITY) {
+      flush();
+      if (n > CAPACITY) {
+        write(text, n);
+        return;
+      }
+    }
+    memcpy(buffer + used, text, n);
+    used += n;
+    if (used >= THRESHOLD) {
+      flush();
+    }
+  }
+
+  void put(const char *text) { put(text, strlen(text)); }
+
+  void put_char(char c) { put(&c, 1); }
+
+  // Escreve o inteiro em decimal sem passar pelo printf
+  void put_int(int32_t value) {
+    char text[12];
+    char *end = text + sizeof(text);
+    char *p = end;
+    uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    do {
+      *--p = '0' + magnitude % 10;
+      magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0) {
+      *--p = '-';
+    }
+    put(p, end - p);
+  }
+
+  // Le um caractere da entrada, EOF no fim
+  int get_char() {
+    flush();
+    return in == nullptr ? EOF : fgetc(in);
+  }
+
+  // Le ate n bytes da entrada, parando depois do fim de linha como a leitura
+  // de um terminal. Devolve o numero de bytes lidos.
+  size_t get_line(char *text, size_t n) {
+    flush();
+    size_t count = 0;
+    while (in != nullptr && count < n) {
+      int c = fgetc(in);
+      if (c == EOF) {
+        break;
+      }
+      text[count++] = c;
+      if (c == '\n') {
+        break;
+      }
+    }
+    return count;
+  }
+
+  // Escreve tudo o que esta no buffer no destino
+  void flush() {
+    write(buffer, used);
+    used = 0;
+    if (capture == nullptr) {
+      fflush(out);
+    }
+  }
+
+ private:
+  char buffer[CAPACITY];
+  size_t used;  // bytes ocupados no buffer
+
+  void write(const char *text, size_t n) {
+    if (n == 0) {
+      return;
+    }
+    if (capture != nullptr) {
+      capture->append(text, n);
+    } else {
+      fwrite(text, 1, n, out);
+    }
+  }
+};
+
+#endif
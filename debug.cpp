@@ -0,0 +1,516 @@
+/*
+ *  debug.cpp
+ *
+ * Depurador interativo (main.exe -d). O programa roda no motor threaded sob
+ * comandos lidos da entrada padrao: passo a passo, continue ate um
+ * breakpoint no PC ou um watchpoint nas escritas num intervalo da memoria, e
+ * inspecao dos registradores, da memoria e do codigo desmontado
+ * (disasm.cpp).
+ *
+ * Breakpoints e watchpoints nao custam nada no laco do motor, nem quando
+ * existem: so durante o continue, o handler da entrada de cada breakpoint e
+ * trocado pelo h_break, que para o laco sem executar a instrucao, e o de cada
+ * store ja decodificado pelo h_watch, que faz o store e para o laco se ele
+ * escreveu num intervalo vigiado; um store decodificado durante o continue
+ * recebe o h_watch no h_decode. Na parada os handlers originais voltam. Os
+ * pares fundidos (threaded.cpp) cuja segunda instrucao tem um breakpoint sao
+ * desfeitos, para ela nao rodar dentro do handler do par. O continue sai do
+ * breakpoint em que o programa esta parado com um passo sem as trocas.
+ *
+ * Um breakpoint numa instrucao reescrita pelo programa durante o continue
+ * so volta no continue seguinte, e as escritas em bloco dos ecalls nao
+ * passam pelos watchpoints.
+ */
+
+#include <strings.h>
+
+enum { DEBUG_LIST = 8 };   // instrucoes do comando l sem contagem
+enum { DEBUG_WORDS = 8 };  // palavras do comando x sem contagem
+
+// Motivo da parada do ultimo continue
+enum DEBUG_STOPS { D_NONE, D_BREAK, D_WATCH };
+
+// Breakpoint (size = 0) ou watchpoint nas escritas em [address, address +
+// size)
+//
+struct DebugPoint {
+  int id;
+  uint32_t address, size;
+  Handler saved;  // handler trocado pelo h_break durante o continue
+};
+
+struct Debugger {
+  vector<DebugPoint> points;
+  int next_id;
+  bool watching;  // continue em andamento com algum watchpoint
+  uint64_t limit;  // instret_limit do programa (-l)
+  DEBUG_STOPS stop;
+  // Ultimo watchpoint atingido: o ponto, o PC do store e o que ele escreveu
+  int watch_id;
+  uint32_t watch_pc, watch_address, watch_size;
+};
+
+/********************************* HANDLERS **********************************/
+
+// Bytes escritos por uma instrucao, 0 se ela nao escreve na memoria
+//
+uint32_t debug_store_size(INSTRUCTIONS instruction) {
+  switch (instruction) {
+    case I_sb:
+      return 1;
+    case I_sh:
+      return 2;
+    case I_sw:
+    case I_sc_w:
+    case I_amoswap_w:
+    case I_amoadd_w:
+    case I_amoxor_w:
+    case I_amoand_w:
+    case I_amoor_w:
+    case I_amomin_w:
+    case I_amomax_w:
+    case I_amominu_w:
+    case I_amomaxu_w:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+// Handler da entrada de um breakpoint: para o laco sem executar a
+// instrucao. O laco conta uma instrucao depois de cada handler, entao o
+// instret volta uma antes.
+//
+void h_break(Hart &h, const DecodedInstr &) {
+  h.debugger->stop = D_BREAK;
+  h.instret_limit = h.instret;
+  h.instret--;
+}
+
+// Handler dos stores durante o continue com watchpoints: faz o store e, se
+// ele escreveu num intervalo vigiado, para o laco depois dele
+//
+void h_watch(Hart &h, const DecodedInstr &d) {
+  uint32_t address = h.breg[d.rs1] + d.imm;
+  uint32_t at = h.pc;
+  handlers[d.instruction](h, d);
+  // o sc.w que falhou nao escreve; o x0 so e zerado depois do handler
+  if (h.mem.fault || (d.instruction == I_sc_w && h.breg[d.rd] != 0)) {
+    return;
+  }
+  Debugger &g = *h.debugger;
+  uint32_t size = debug_store_size(d.instruction);
+  for (const DebugPoint &p : g.points) {
+    if (p.size != 0 && (uint64_t)p.address + p.size > address &&
+        (uint64_t)address + size > p.address) {
+      g.stop = D_WATCH;
+      g.watch_id = p.id;
+      g.watch_pc = at;
+      g.watch_address = address;
+      g.watch_size = size;
+      h.instret_limit = h.instret + 1;
+      return;
+    }
+  }
+}
+
+// Chamado pelo h_decode depois de instalar o handler de uma instrucao
+//
+void debug_decoded(Hart &h, DecodedInstr &d) {
+  if (h.debugger->watching && debug_store_size(d.instruction) != 0) {
+    d.handler = h_watch;
+  }
+}
+
+// Troca os handlers para o continue
+//
+void debug_patch(Hart &h, Debugger &g) {
+  g.watching = false;
+  for (const DebugPoint &p : g.points) {
+    g.watching = g.watching || p.size != 0;
+  }
+  for (DecodedInstr &d : h.decoded_cache) {
+    if (g.watching && d.valid && debug_store_size(d.instruction) != 0) {
+      d.handler = h_watch;
+    }
+  }
+  for (DebugPoint &p : g.points) {
+    if (p.size != 0) {
+      continue;
+    }
+    for (uint32_t a = p.address - 4; a != p.address; a += 2) {
+      if (h.in_text(a) && h.decoded(a).fused) {
+        h.decoded(a).fused = false;
+        h.decoded(a).handler = h_decode;
+      }
+    }
+    DecodedInstr &d = h.decoded(p.address);
+    p.saved = d.handler;
+    d.handler = h_break;
+  }
+}
+
+// Devolve os handlers trocados pelo debug_patch. Uma entrada invalidada
+// durante o continue ja voltou para o h_decode.
+//
+void debug_unpatch(Hart &h, Debugger &g) {
+  for (const DebugPoint &p : g.points) {
+    DecodedInstr &d = h.decoded(p.address);
+    if (p.size == 0 && d.handler == h_break) {
+      d.handler = p.saved;
+    }
+  }
+  for (DecodedInstr &d : h.decoded_cache) {
+    if (d.handler == h_watch) {
+      d.handler = handlers[d.instruction];
+    }
+  }
+  g.watching = false;
+}
+
+/********************************* EXECUCAO **********************************/
+
+// Roda no maximo count instrucoes; com patch, para tambem nos breakpoints e
+// watchpoints
+//
+void debug_resume(Hart &h, Debugger &g, uint64_t count, bool patch) {
+  g.stop = D_NONE;
+  h.instret_limit = count < g.limit - h.instret ? h.instret + count : g.limit;
+  if (patch) {
+    debug_patch(h, g);
+  }
+  h.resume_threaded();
+  if (patch) {
+    debug_unpatch(h, g);
+  }
+  h.instret_limit = g.limit;
+  h.console.flush();
+}
+
+// Breakpoint em address, -1 se nao houver
+//
+int debug_break_at(Debugger &g, uint32_t address) {
+  for (const DebugPoint &p : g.points) {
+    if (p.size == 0 && p.address == address) {
+      return p.id;
+    }
+  }
+  return -1;
+}
+
+// Continua ate um breakpoint, um watchpoint, o fim do programa ou, no
+// maximo, count instrucoes
+//
+void debug_continue(Hart &h, Debugger &g, uint64_t count) {
+  if (debug_break_at(g, h.pc) >= 0) {
+    debug_resume(h, g, 1, false);
+    if (!h.running() || --count == 0) {
+      return;
+    }
+  }
+  debug_resume(h, g, count, true);
+}
+
+// Cria um breakpoint (size = 0) ou watchpoint e devolve o id dele
+//
+int debug_add_point(Debugger &g, uint32_t address, uint32_t size) {
+  g.points.push_back(DebugPoint{g.next_id, address, size, nullptr});
+  return g.next_id++;
+}
+
+// Apaga o breakpoint ou watchpoint id. Devolve false se ele nao existe.
+//
+bool debug_delete_point(Debugger &g, int id) {
+  for (size_t i = 0; i < g.points.size(); i++) {
+    if (g.points[i].id == id) {
+      g.points.erase(g.points.begin() + i);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Prepara o programa ja carregado em h para rodar sob o depurador g
+//
+void debug_start(Hart &h, Debugger &g) {
+  g.next_id = 1;
+  g.watching = false;
+  g.stop = D_NONE;
+  g.limit = h.instret_limit;
+  h.start_engine(E_THREADED);
+  h.debugger = &g;
+}
+
+/********************************* INSPECAO **********************************/
+
+// Le n bytes da memoria do programa sem deixar uma falta registrada no hart
+//
+bool debug_read(Hart &h, uint32_t address, void *dst, uint32_t n) {
+  bool fault = h.mem.fault;
+  uint32_t fault_address = h.mem.fault_address;
+  bool ok = h.read_bytes(address, dst, n);
+  h.mem.fault = fault;
+  h.mem.fault_address = fault_address;
+  return ok;
+}
+
+// Escreve n bytes na memoria do programa, como o debug_read
+//
+bool debug_write(Hart &h, uint32_t address, const void *src, uint32_t n) {
+  bool fault = h.mem.fault;
+  uint32_t fault_address = h.mem.fault_address;
+  bool ok = h.write_bytes(address, src, n);
+  h.mem.fault = fault;
+  h.mem.fault_address = fault_address;
+  return ok;
+}
+
+// Le a instrucao em address como o read_instr(), sem faltas. Devolve false
+// se ela nao esta mapeada.
+//
+bool debug_fetch(Hart &h, uint32_t address, uint32_t &word, uint32_t &size) {
+  uint16_t low, high;
+  if (!debug_read(h, address, &low, 2)) {
+    return false;
+  }
+  if ((low & 3) != 3) {
+    size = 2;
+    word = rvc_expand(low);
+    return true;
+  }
+  if (!debug_read(h, address + 2, &high, 2)) {
+    return false;
+  }
+  size = 4;
+  word = low | (uint32_t)high << 16;
+  return true;
+}
+
+// Desmonta count instrucoes a partir de address. => marca o PC e * os
+// breakpoints; o nome da funcao aparece no endereco do seu simbolo.
+//
+void debug_list(Hart &h, Debugger &g, uint32_t address, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    auto symbol = h.functions.find(address);
+    if (symbol != h.functions.end()) {
+      printf("%s:\n", symbol->second.c_str());
+    }
+    uint32_t word, size;
+    if (!debug_fetch(h, address, word, size)) {
+      printf("%08x  endereco nao mapeado\n", address);
+      return;
+    }
+    printf("%s%c ", address == h.pc ? "=>" : "  ",
+           debug_break_at(g, address) >= 0 ? '*' : ' ');
+    print_instr(address, word, size == 2);
+    printf("\n");
+    address += size;
+  }
+}
+
+// Imprime count palavras a partir de address, quatro por linha
+//
+void debug_dump(Hart &h, uint32_t address, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++, address += 4) {
+    if (i % 4 == 0) {
+      printf(i == 0 ? "%08x:" : "\n%08x:", address);
+    }
+    uint32_t word;
+    if (debug_read(h, address, &word, 4)) {
+      printf("  %08x", word);
+    } else {
+      printf("  --------");
+    }
+  }
+  printf("\n");
+}
+
+void debug_info(Hart &h, Debugger &g) {
+  if (g.points.empty()) {
+    printf("Nenhum breakpoint ou watchpoint\n");
+  }
+  for (const DebugPoint &p : g.points) {
+    if (p.size == 0) {
+      string owner = profile_owner(h, p.address);
+      printf("%3d  breakpoint  %08x %s\n", p.id, p.address, owner.c_str());
+    } else {
+      printf("%3d  watchpoint  %08x, %u bytes\n", p.id, p.address, p.size);
+    }
+  }
+}
+
+/********************************* COMANDOS **********************************/
+
+const char *const debug_help =
+    "s [n]             executa n instrucoes (padrao 1)\n"
+    "c                 continua ate um breakpoint, um watchpoint ou o fim\n"
+    "b endereco        breakpoint no endereco\n"
+    "w endereco [n]    watchpoint nas escritas em n bytes (padrao 4)\n"
+    "d id              apaga o breakpoint ou watchpoint id\n"
+    "i                 lista os breakpoints e watchpoints\n"
+    "r                 imprime o PC e os registradores\n"
+    "x endereco [n]    imprime n palavras da memoria (padrao 8)\n"
+    "l [endereco] [n]  desmonta n instrucoes (padrao: 8 a partir do PC)\n"
+    "q                 termina\n"
+    "Enderecos sao numeros (0x para hexadecimal), registradores, pc ou nomes\n"
+    "de funcao do ELF.\n"
+    "Linha vazia repete o comando anterior.\n";
+
+// Le um endereco: numero, registrador (o valor dele), pc ou nome de uma
+// funcao do ELF. Devolve false se nao for nenhum deles.
+//
+bool debug_address(Hart &h, const char *text, uint32_t &address) {
+  char *end;
+  unsigned long value = strtoul(text, &end, 0);
+  if (end != text && *end == '\0') {
+    address = value;
+    return true;
+  }
+  for (int i = 0; i < 32; i++) {
+    if (strcasecmp(text, reg_str[i]) == 0) {
+      address = h.breg[i];
+      return true;
+    }
+  }
+  if (strcasecmp(text, "pc") == 0) {
+    address = h.pc;
+    return true;
+  }
+  for (const auto &symbol : h.functions) {
+    if (symbol.second == text) {
+      address = symbol.first;
+      return true;
+    }
+  }
+  printf("Endereco invalido: %s\n", text);
+  return false;
+}
+
+// Imprime por que o programa parou e a instrucao do PC
+//
+void debug_report(Hart &h, Debugger &g) {
+  if (!h.running()) {
+    h.report_finish();
+    return;
+  }
+  if (g.stop == D_BREAK) {
+    printf("Breakpoint %d\n", debug_break_at(g, h.pc));
+  } else if (g.stop == D_WATCH) {
+    uint32_t value = 0;
+    debug_read(h, g.watch_address, &value, g.watch_size);
+    printf("Watchpoint %d: o store em %08x escreveu %0*x em %08x\n",
+           g.watch_id, g.watch_pc, g.watch_size * 2, value, g.watch_address);
+  }
+  debug_list(h, g, h.pc, 1);
+}
+
+// Executa uma linha de comando. Devolve false no q.
+//
+bool debug_command(Hart &h, Debugger &g, const char *line) {
+  char command[16], first[64], second[64];
+  int args = sscanf(line, "%15s %63s %63s", command, first, second) - 1;
+  if (args < 0) {
+    return true;
+  }
+  uint32_t address = h.pc;
+  uint32_t count = args >= 2 ? strtoul(second, nullptr, 0) : 0;
+  bool finished = h.exit_reason != EXIT_RUNNING;
+  switch (command[0]) {
+    case 's':
+    case 'c':
+      if (finished) {
+        printf("O programa terminou\n");
+      } else if (command[0] == 'c') {
+        debug_continue(h, g, UINT64_MAX);
+        debug_report(h, g);
+      } else {
+        debug_resume(h, g, args >= 1 ? strtoull(first, nullptr, 0) : 1,
+                     false);
+        debug_report(h, g);
+      }
+      break;
+    case 'b':
+      if (args < 1 || !debug_address(h, first, address)) {
+        break;
+      }
+      if (!h.in_text(address) || (address & 1) != 0) {
+        printf("%08x nao e uma instrucao do segmento de texto\n", address);
+      } else if (debug_break_at(g, address) >= 0) {
+        printf("Ja existe um breakpoint em %08x\n", address);
+      } else {
+        printf("Breakpoint %d em %08x\n", debug_add_point(g, address, 0),
+               address);
+      }
+      break;
+    case 'w':
+      if (args < 1 || !debug_address(h, first, address)) {
+        break;
+      }
+      count = args >= 2 ? count : 4;
+      if (count == 0) {
+        printf("Intervalo vazio\n");
+      } else {
+        printf("Watchpoint %d em %08x, %u bytes\n",
+               debug_add_point(g, address, count), address, count);
+      }
+      break;
+    case 'd':
+      if (args < 1 || !debug_delete_point(g, atoi(first))) {
+        printf("Breakpoint ou watchpoint inexistente\n");
+      }
+      break;
+    case 'i':
+      debug_info(h, g);
+      break;
+    case 'r':
+      printf("PC = %08x, %llu instrucoes executadas\n", h.pc,
+             (unsigned long long)h.instret);
+      h.dump_breg();
+      break;
+    case 'x':
+      if (args >= 1 && debug_address(h, first, address)) {
+        debug_dump(h, address, args >= 2 ? count : (uint32_t)DEBUG_WORDS);
+      }
+      break;
+    case 'l':
+      if (args < 1 || debug_address(h, first, address)) {
+        debug_list(h, g, address, args >= 2 ? count : (uint32_t)DEBUG_LIST);
+      }
+      break;
+    case 'q':
+      return false;
+    default:
+      printf("%s", debug_help);
+      break;
+  }
+  return true;
+}
+
+// Depura o programa ja carregado em h, lendo os comandos da entrada padrao
+// ate o q ou o fim dela
+//
+void run_debugger(Hart &h) {
+  Debugger g;
+  debug_start(h, g);
+  printf("Depurador: h para ajuda\n");
+  debug_list(h, g, h.pc, 1);
+  char line[256];
+  string last;
+  while (true) {
+    printf("(rv) ");
+    fflush(stdout);
+    if (fgets(line, sizeof(line), stdin) == nullptr) {
+      printf("\n");
+      break;
+    }
+    if (line[strspn(line, " \t\r\n")] == '\0') {
+      snprintf(line, sizeof(line), "%s", last.c_str());
+    }
+    last = line;
+    if (!debug_command(h, g, line)) {
+      break;
+    }
+  }
+  h.debugger = nullptr;
+  h.console.flush();
+}
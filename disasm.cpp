@@ -0,0 +1,67 @@
+/*
+ *  disasm.cpp
+ *
+ * Desmontador: o texto de uma instrucao de 32 bits (as comprimidas ja
+ * expandidas pelo rvc_expand) com os nomes de instr_info e de reg_str, na
+ * ordem do RARS: destino primeiro, loads e stores como imediato(base) e
+ * desvios e jal com o endereco de destino. Usado pelo -T, pelo relatorio do
+ * lockstep e pelo depurador (debug.cpp).
+ */
+
+// Escreve em text (n bytes) o texto da instrucao word, que esta em pc
+//
+void disassemble(char *text, size_t n, uint32_t pc, uint32_t word) {
+  INSTRUCTIONS instruction = decode_lookup(word);
+  const InstrInfo &info = instr_info[instruction];
+  const char *rd = reg_str[(word >> 7) & 0x1F];
+  const char *rs1 = reg_str[(word >> 15) & 0x1F];
+  const char *rs2 = reg_str[(word >> 20) & 0x1F];
+  int32_t imm = instr_imm(word, info.imm);
+  switch (instruction) {
+    case I_nop:
+      snprintf(text, n, "invalida");
+      return;
+    case I_ecall:
+      snprintf(text, n, "%s", info.name);
+      return;
+    case I_fence:
+      snprintf(text, n, ((word >> 12) & 7) == FENCEI3 ? "FENCE.I" : "FENCE");
+      return;
+    case I_lr_w:
+      snprintf(text, n, "%-10s %s, (%s)", info.name, rd, rs1);
+      return;
+    default:
+      break;
+  }
+  switch (info.format) {
+    case RType:
+      if (info.opcode == AMO) {
+        snprintf(text, n, "%-10s %s, %s, (%s)", info.name, rd, rs2, rs1);
+      } else {
+        snprintf(text, n, "%-10s %s, %s, %s", info.name, rd, rs1, rs2);
+      }
+      break;
+    case IType:
+      if (info.opcode == ILType || info.opcode == JALR) {
+        snprintf(text, n, "%-10s %s, %d(%s)", info.name, rd, imm, rs1);
+      } else {
+        snprintf(text, n, "%-10s %s, %s, %d", info.name, rd, rs1, imm);
+      }
+      break;
+    case SType:
+      snprintf(text, n, "%-10s %s, %d(%s)", info.name, rs2, imm, rs1);
+      break;
+    case SBType:
+      snprintf(text, n, "%-10s %s, %s, %08x", info.name, rs1, rs2, pc + imm);
+      break;
+    case UType:
+      snprintf(text, n, "%-10s %s, 0x%x", info.name, rd, imm);
+      break;
+    case UJType:
+      snprintf(text, n, "%-10s %s, %08x", info.name, rd, pc + imm);
+      break;
+    default:
+      snprintf(text, n, "%s", info.name);
+      break;
+  }
+}
@@ -0,0 +1,223 @@
+/*
+ *  elf.cpp
+ *
+ * Carregador de executaveis ELF32 RISC-V (little endian, ET_EXEC), gerados
+ * direto pelo GCC/Clang riscv32, sem precisar do objcopy para os dumps.
+ *
+ * Cada segmento PT_LOAD e mapeado no seu endereco virtual com o mesmo mmap
+ * copy-on-write dos dumps (ver mem_map_file), ou copiado se o mmap nao der.
+ * O que passa do arquivo (.bss) so e mapeado: as paginas comecam zeradas e so
+ * sao alocadas na primeira escrita. Os segmentos executaveis formam o
+ * segmento de texto do hart. A memoria do layout do RARS, mapeada pelo
+ * construtor do Hart, e descartada antes, entao o endereco 0 da falta.
+ *
+ * O PC inicial vem de e_entry, o gp do simbolo __global_pointer$ e o sp do
+ * primeiro simbolo de topo de pilha encontrado (ELF_STACK_SYMBOLS). Sem
+ * simbolo o sp fica em ELF_STACK_TOP - 4 (0x7fffeffc) e sem
+ * __global_pointer$ o gp fica zerado. O heap (sbrk) comeca na pagina seguinte
+ * ao fim do ultimo segmento.
+ */
+
+enum { ELF_CLASS32 = 1, ELF_DATA2LSB = 1, ELF_EXEC = 2, ELF_RISCV = 243 };
+enum { ELF_PT_LOAD = 1, ELF_PF_X = 1 };
+enum { ELF_SHT_SYMTAB = 2, ELF_STT_FUNC = 2 };
+
+enum : uint32_t { ELF_STACK_TOP = 0x7ffff000 };  // sp padrao: 0x7fffeffc
+enum : uint32_t { ELF_STACK_SIZE = 8 << 20 };    // mapeado abaixo do sp
+
+const char *ELF_STACK_SYMBOLS[] = {"__stack_top", "_stack_top", "__stack",
+                                   "_sp"};
+
+struct Elf32Header {
+  uint8_t ident[16];
+  uint16_t type, machine;
+  uint32_t version, entry, phoff, shoff, flags;
+  uint16_t ehsize, phentsize, phnum, shentsize, shnum, shstrndx;
+};
+
+struct Elf32ProgramHeader {
+  uint32_t type, offset, vaddr, paddr, filesz, memsz, flags, align;
+};
+
+struct Elf32SectionHeader {
+  uint32_t name, type, flags, addr, offset, size, link, info, addralign,
+      entsize;
+};
+
+struct Elf32Symbol {
+  uint32_t name, value, size;
+  uint8_t info, other;
+  uint16_t shndx;
+};
+
+static_assert(sizeof(Elf32Header) == 52, "cabecalho ELF32");
+static_assert(sizeof(Elf32ProgramHeader) == 32, "program header ELF32");
+static_assert(sizeof(Elf32SectionHeader) == 40, "section header ELF32");
+static_assert(sizeof(Elf32Symbol) == 16, "simbolo ELF32");
+
+// Le count estruturas a partir de offset
+//
+template <typename T>
+bool elf_read(FILE *fptr, uint32_t offset, vector<T> &out, size_t count) {
+  out.resize(count);
+  return count == 0 || (fseek(fptr, offset, SEEK_SET) == 0 &&
+                        fread(out.data(), sizeof(T), count, fptr) == count);
+}
+
+// Diz se o arquivo comeca com o magic do ELF
+//
+bool is_elf(const char *fn) {
+  FILE *fptr = fopen(fn, "rb");
+  if (fptr == nullptr) {
+    return false;
+  }
+  char magic[4];
+  bool elf =
+      fread(magic, 1, 4, fptr) == 4 && memcmp(magic, "\x7f" "ELF", 4) == 0;
+  fclose(fptr);
+  return elf;
+}
+
+// Carrega um segmento PT_LOAD: a parte do arquivo com mmap ou copia, e o
+// resto (.bss) so mapeado.
+//
+bool elf_load_segment(Memory *mem, FILE *fptr, const Elf32ProgramHeader &p) {
+  if ((uint64_t)p.vaddr + p.memsz > (uint64_t)ALLONE + 1 ||
+      p.filesz > p.memsz) {
+    return false;
+  }
+  if (p.filesz > 0) {
+    int64_t size = -1;
+#ifdef __unix__
+    size = mem_map_file(mem, fileno(fptr), p.offset, p.filesz, p.vaddr);
+#endif
+    if (size < 0 && fseek(fptr, p.offset, SEEK_SET) == 0) {
+      size = mem_copy_file(mem, fptr, p.vaddr, p.filesz);
+    }
+    if (size != p.filesz) {
+      return false;
+    }
+  }
+  if (p.memsz > p.filesz) {
+    uint32_t bss = p.vaddr + p.filesz;
+    uint32_t bss_size = p.memsz - p.filesz;
+    mem_map(mem, bss, bss_size);
+    // a ultima pagina do arquivo continua com bytes de fora do segmento
+    if (p.filesz > 0 && (bss & (PAGE_BYTES - 1)) != 0) {
+      uint32_t room = PAGE_BYTES - (bss & (PAGE_BYTES - 1));
+      mem_zero(mem, bss, min(room, bss_size));
+    }
+  }
+  return true;
+}
+
+// Procura os simbolos que definem sp e gp na tabela de simbolos e guarda os
+// nomes das funcoes
+//
+void elf_symbols(FILE *fptr, const Elf32Header &eh, Hart &h, bool &has_sp) {
+  vector<Elf32SectionHeader> sections;
+  if (eh.shentsize != sizeof(Elf32SectionHeader) ||
+      !elf_read(fptr, eh.shoff, sections, eh.shnum)) {
+    return;
+  }
+  for (const Elf32SectionHeader &sh : sections) {
+    if (sh.type != ELF_SHT_SYMTAB || sh.link >= sections.size()) {
+      continue;
+    }
+    vector<Elf32Symbol> symbols;
+    vector<char> names;
+    const Elf32SectionHeader &strtab = sections[sh.link];
+    if (!elf_read(fptr, sh.offset, symbols, sh.size / sizeof(Elf32Symbol)) ||
+        !elf_read(fptr, strtab.offset, names, strtab.size)) {
+      return;
+    }
+    names.push_back('\0');
+    int stack_rank = sizeof(ELF_STACK_SYMBOLS) / sizeof(ELF_STACK_SYMBOLS[0]);
+    for (const Elf32Symbol &sym : symbols) {
+      if (sym.name >= names.size()) {
+        continue;
+      }
+      const char *name = &names[sym.name];
+      if ((sym.info & 0xf) == ELF_STT_FUNC) {
+        h.functions[sym.value] = name;
+      }
+      if (strcmp(name, "__global_pointer$") == 0) {
+        h.gp = sym.value;
+      }
+      for (int i = 0; i < stack_rank; i++) {
+        if (strcmp(name, ELF_STACK_SYMBOLS[i]) == 0) {
+          h.sp = sym.value;
+          has_sp = true;
+          stack_rank = i;  // os primeiros da lista tem preferencia
+          break;
+        }
+      }
+    }
+  }
+}
+
+// Carrega um executavel ELF32 RISC-V. Imprime o erro e devolve false se o
+// arquivo nao for valido.
+//
+bool Hart::load_elf(const char *fn) {
+  FILE *fptr = fopen(fn, "rb");
+  if (!fptr) {
+    printf("Arquivo nao encontrado!\n");
+    return false;
+  }
+  vector<Elf32Header> header;
+  vector<Elf32ProgramHeader> segments;
+  if (!elf_read(fptr, 0, header, 1) ||
+      memcmp(header[0].ident, "\x7f" "ELF", 4) != 0 ||
+      header[0].ident[4] != ELF_CLASS32 ||
+      header[0].ident[5] != ELF_DATA2LSB ||
+      header[0].type != ELF_EXEC || header[0].machine != ELF_RISCV ||
+      header[0].phentsize != sizeof(Elf32ProgramHeader) ||
+      !elf_read(fptr, header[0].phoff, segments, header[0].phnum)) {
+    printf("%s nao e um executavel ELF32 RISC-V\n", fn);
+    fclose(fptr);
+    return false;
+  }
+  const Elf32Header &eh = header[0];
+
+  // fora dos segmentos, da pilha e do heap nada fica mapeado
+  mem_release(&mem);
+  brk = 0;
+  uint32_t text_begin = ALLONE;
+  uint64_t text_end = 0;  // um segmento pode terminar em 4 GiB
+  for (const Elf32ProgramHeader &p : segments) {
+    if (p.type != ELF_PT_LOAD || p.memsz == 0) {
+      continue;
+    }
+    if (!elf_load_segment(&mem, fptr, p)) {
+      printf("%s: erro ao carregar o segmento em %08x\n", fn, p.vaddr);
+      fclose(fptr);
+      return false;
+    }
+    if (p.flags & ELF_PF_X) {
+      text_begin = min(text_begin, p.vaddr);
+      text_end = max<uint64_t>(text_end, (uint64_t)p.vaddr + p.memsz);
+    }
+    uint64_t end = ((uint64_t)p.vaddr + p.memsz + PAGE_BYTES - 1) &
+                   ~(uint64_t)(PAGE_BYTES - 1);
+    brk = max<uint64_t>(brk, min<uint64_t>(end, ALLONE));
+  }
+  if (text_end == 0) {
+    printf("%s: nenhum segmento executavel\n", fn);
+    fclose(fptr);
+    return false;
+  }
+  set_text(text_begin, min<uint64_t>(text_end - text_begin, ALLONE));
+  entry = eh.entry;
+
+  bool has_sp = false;
+  gp = 0;  // o 0x1800 do RARS nao esta mais mapeado
+  elf_symbols(fptr, eh, *this, has_sp);
+  if (!has_sp) {
+    sp = ELF_STACK_TOP - 4;
+  }
+  uint32_t stack = sp > ELF_STACK_SIZE ? sp - ELF_STACK_SIZE : 0;
+  mem_map(&mem, stack, sp - stack + 4);
+  fclose(fptr);
+  return true;
+}
@@ -0,0 +1,492 @@
+/*
+ *  gdbstub.cpp
+ *
+ * Servidor do protocolo remoto do GDB (main.exe -g porta|caminho). Espera
+ * uma conexao do riscv32-unknown-elf-gdb numa porta TCP de localhost ou num
+ * socket Unix, e o GDB le e escreve os registradores (breg e pc) e a
+ * memoria, poe breakpoints (Z0, Z1) e watchpoints de escrita (Z2), e roda o
+ * programa passo a passo (s) ou ate uma parada (c). No GDB:
+ *   target remote localhost:1234   ou   target remote /tmp/rv.sock
+ *
+ * A execucao e a do depurador (debug.cpp): entre as paradas o programa roda
+ * no motor threaded com os breakpoints e watchpoints trocados nos handlers,
+ * sem nenhum teste por instrucao. O continue roda em fatias de GDB_QUANTUM
+ * instrucoes e entre elas olha se o GDB mandou um Ctrl-C.
+ *
+ * O alvo tem uma thread so. Os registradores sao descritos no target.xml
+ * (qXfer:features:read) com os nomes da ABI, x0 a x31 e o pc. Uma falta de
+ * memoria para o programa com SIGSEGV, ainda inspecionavel; o continue
+ * seguinte termina o programa.
+ */
+
+#ifdef __unix__
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cctype>
+
+enum { GDB_QUANTUM = 1 << 20 };  // instrucoes entre as olhadas no Ctrl-C
+enum { GDB_PACKET_SIZE = 4096 };  // maior pacote, anunciado no qSupported
+enum { GDB_REGS = 33 };           // x0 a x31 e o pc
+
+// Sinais das respostas de parada
+enum { GDB_SIGINT = 2, GDB_SIGTRAP = 5, GDB_SIGSEGV = 11 };
+
+struct GdbStub {
+  int fd;
+  Debugger debugger;
+  char buffer[GDB_PACKET_SIZE];  // bytes recebidos em [begin, end)
+  size_t begin, end;
+  string stop;           // ultima resposta de parada, para o ?
+  bool fault_reported;  // a falta de memoria ja parou o programa
+  bool finished;        // o programa terminou ou o GDB mandou k
+  bool detached;        // o GDB mandou D
+};
+
+/********************************** CONEXAO **********************************/
+
+// Espera a conexao do GDB em where: uma porta TCP de localhost ou o caminho
+// de um socket Unix. Devolve o socket conectado, -1 se nao conseguir.
+//
+int gdb_accept(const char *where) {
+  char *end;
+  unsigned long port = strtoul(where, &end, 10);
+  bool tcp = end != where && *end == '\0';
+  int listener = socket(tcp ? AF_INET : AF_UNIX, SOCK_STREAM, 0);
+  int status = -1;
+  if (listener >= 0 && tcp) {
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    status = bind(listener, (sockaddr *)&address, sizeof(address));
+  } else if (listener >= 0) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (strlen(where) < sizeof(address.sun_path)) {
+      strcpy(address.sun_path, where);
+      unlink(where);
+      status = bind(listener, (sockaddr *)&address, sizeof(address));
+    }
+  }
+  if (status != 0 || listen(listener, 1) != 0) {
+    printf("Nao foi possivel abrir %s\n", where);
+    if (listener >= 0) {
+      close(listener);
+    }
+    return -1;
+  }
+  printf("Esperando o GDB em %s\n", where);
+  fflush(stdout);
+  int fd = accept(listener, nullptr, nullptr);
+  close(listener);
+  if (!tcp) {
+    unlink(where);
+  }
+  if (fd >= 0 && tcp) {
+    int one = 1;  // cada passo e um pacote pequeno
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+  return fd;
+}
+
+// Proximo byte do GDB, -1 se a conexao fechou
+//
+int gdb_getc(GdbStub &s) {
+  if (s.begin == s.end) {
+    ssize_t n = recv(s.fd, s.buffer, sizeof(s.buffer), 0);
+    if (n <= 0) {
+      return -1;
+    }
+    s.begin = 0;
+    s.end = n;
+  }
+  return (uint8_t)s.buffer[s.begin++];
+}
+
+void gdb_write(GdbStub &s, const string &data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(s.fd, data.data() + sent, data.size() - sent, 0);
+    if (n <= 0) {
+      return;
+    }
+    sent += n;
+  }
+}
+
+// Le um pacote $dados#checksum e confirma com + (ou pede de novo com -).
+// Devolve false se a conexao fechou.
+//
+bool gdb_read_packet(GdbStub &s, string &packet) {
+  while (true) {
+    int c;
+    do {
+      c = gdb_getc(s);
+    } while (c >= 0 && c != '$');
+    packet.clear();
+    uint8_t sum = 0;
+    while ((c = gdb_getc(s)) >= 0 && c != '#') {
+      packet += (char)c;
+      sum += c;
+    }
+    char checksum[3] = {(char)gdb_getc(s), (char)gdb_getc(s), '\0'};
+    if (c < 0 || checksum[1] == (char)-1) {
+      return false;
+    }
+    bool ok = strtoul(checksum, nullptr, 16) == sum;
+    gdb_write(s, ok ? "+" : "-");
+    if (ok) {
+      return true;
+    }
+  }
+}
+
+// Manda um pacote e espera a confirmacao, mandando de novo a cada -
+//
+void gdb_send(GdbStub &s, const string &data) {
+  uint8_t sum = 0;
+  for (char c : data) {
+    sum += c;
+  }
+  char checksum[4];
+  snprintf(checksum, sizeof(checksum), "#%02x", sum);
+  string packet = "$" + data + checksum;
+  int c;
+  do {
+    gdb_write(s, packet);
+    c = gdb_getc(s);
+  } while (c == '-');
+}
+
+// Olha, sem esperar, se o GDB mandou um Ctrl-C (0x03) ou fechou a conexao.
+// So o 0x03 sai do buffer; os outros bytes ficam para o proximo pacote.
+//
+bool gdb_interrupted(GdbStub &s) {
+  pollfd p = {s.fd, POLLIN, 0};
+  if (poll(&p, 1, 0) > 0) {
+    // junta o que chegou ao que ja estava no buffer
+    memmove(s.buffer, s.buffer + s.begin, s.end - s.begin);
+    s.end -= s.begin;
+    s.begin = 0;
+    if (s.end < sizeof(s.buffer)) {
+      ssize_t n = recv(s.fd, s.buffer + s.end, sizeof(s.buffer) - s.end, 0);
+      if (n <= 0) {
+        return true;
+      }
+      s.end += n;
+    }
+  }
+  char *c = (char *)memchr(s.buffer + s.begin, 0x03, s.end - s.begin);
+  if (c == nullptr) {
+    return false;
+  }
+  memmove(c, c + 1, s.buffer + s.end - (c + 1));
+  s.end--;
+  return true;
+}
+
+/********************************** PACOTES **********************************/
+
+string gdb_hex(const void *data, size_t n) {
+  string text;
+  char digits[3];
+  for (size_t i = 0; i < n; i++) {
+    snprintf(digits, sizeof(digits), "%02x", ((const uint8_t *)data)[i]);
+    text += digits;
+  }
+  return text;
+}
+
+// Converte 2 * n digitos hexadecimais de text em n bytes. Devolve false se
+// faltar digito.
+//
+bool gdb_unhex(const char *text, void *data, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    char digits[3] = {text[2 * i], text[2 * i] ? text[2 * i + 1] : '\0',
+                      '\0'};
+    if (!isxdigit((uint8_t)digits[0]) || !isxdigit((uint8_t)digits[1])) {
+      return false;
+    }
+    ((uint8_t *)data)[i] = strtoul(digits, nullptr, 16);
+  }
+  return true;
+}
+
+// Descricao dos registradores para o GDB
+//
+string gdb_target_xml() {
+  string xml =
+      "<?xml version=\"1.0\"?>"
+      "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+      "<target version=\"1.0\">"
+      "<architecture>riscv:rv32</architecture>"
+      "<feature name=\"org.gnu.gdb.riscv.cpu\">";
+  for (int i = 0; i < 32; i++) {
+    string name = reg_str[i];
+    for (char &c : name) {
+      c = tolower(c);
+    }
+    const char *type = i == RA ? "code_ptr" : i >= SP && i <= TP ? "data_ptr"
+                                                                 : "int";
+    xml += "<reg name=\"" + name + "\" bitsize=\"32\" type=\"" + type +
+           "\"/>";
+  }
+  xml += "<reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\"/>";
+  return xml + "</feature></target>";
+}
+
+// Valor do registrador n do GDB: x0 a x31 e o pc
+//
+uint32_t gdb_reg(Hart &h, int n) { return n < 32 ? h.breg[n] : h.pc; }
+
+void gdb_set_reg(Hart &h, int n, uint32_t value) {
+  if (n == 32) {
+    h.pc = value;
+  } else if (n != ZERO) {
+    h.breg[n] = value;
+  }
+}
+
+// Resposta de parada depois de um s ou c. O fim do programa vai como W
+// (exit) ou X (morto por sinal).
+//
+string gdb_stop(GdbStub &s, Hart &h, bool interrupted) {
+  Debugger &g = s.debugger;
+  char reply[32];
+  if (h.running() && g.stop == D_WATCH) {
+    snprintf(reply, sizeof(reply), "T%02xwatch:%x;", GDB_SIGTRAP,
+             g.watch_address);
+  } else if (h.running()) {
+    snprintf(reply, sizeof(reply), "T%02x",
+             interrupted ? GDB_SIGINT : GDB_SIGTRAP);
+  } else if (h.mem.fault && !s.fault_reported) {
+    s.fault_reported = true;
+    snprintf(reply, sizeof(reply), "T%02x", GDB_SIGSEGV);
+  } else {
+    h.report_finish();
+    s.finished = true;
+    if (h.mem.fault) {
+      snprintf(reply, sizeof(reply), "X%02x", GDB_SIGSEGV);
+    } else {
+      snprintf(reply, sizeof(reply), "W%02x", h.exit_code & 0xFF);
+    }
+  }
+  s.stop = reply;
+  return reply;
+}
+
+// Continue: roda em fatias ate uma parada, o fim ou um Ctrl-C
+//
+string gdb_continue(GdbStub &s, Hart &h) {
+  Debugger &g = s.debugger;
+  bool interrupted = false;
+  debug_continue(h, g, GDB_QUANTUM);
+  while (h.running() && g.stop == D_NONE &&
+         !(interrupted = gdb_interrupted(s))) {
+    debug_resume(h, g, GDB_QUANTUM, true);
+  }
+  return gdb_stop(s, h, interrupted);
+}
+
+// Z e z: poe ou tira um breakpoint (tipos 0 e 1) ou watchpoint de escrita
+// (tipo 2)
+//
+string gdb_point(GdbStub &s, Hart &h, const char *packet) {
+  unsigned type, address, kind;
+  if (sscanf(packet + 1, "%x,%x,%x", &type, &address, &kind) != 3 ||
+      type > 2) {
+    return "";  // tipo nao suportado
+  }
+  uint32_t size = type == 2 ? kind : 0;
+  if (size == 0 && (!h.in_text(address) || (address & 1) != 0)) {
+    return "E01";
+  }
+  Debugger &g = s.debugger;
+  for (const DebugPoint &p : g.points) {
+    if (p.address == address && p.size == size) {
+      if (packet[0] == 'z') {
+        debug_delete_point(g, p.id);
+      }
+      return "OK";
+    }
+  }
+  if (packet[0] == 'Z') {
+    debug_add_point(g, address, size);
+  }
+  return "OK";
+}
+
+// Pacotes q: capacidades, threads e o target.xml
+//
+string gdb_query(const char *packet) {
+  unsigned offset, length;
+  if (strncmp(packet, "qSupported", 10) == 0) {
+    char reply[64];
+    snprintf(reply, sizeof(reply), "PacketSize=%x;qXfer:features:read+",
+             GDB_PACKET_SIZE);
+    return reply;
+  } else if (strcmp(packet, "qAttached") == 0) {
+    return "1";
+  } else if (strcmp(packet, "qC") == 0) {
+    return "QC1";
+  } else if (strcmp(packet, "qfThreadInfo") == 0) {
+    return "m1";
+  } else if (strcmp(packet, "qsThreadInfo") == 0) {
+    return "l";
+  } else if (sscanf(packet, "qXfer:features:read:target.xml:%x,%x", &offset,
+                    &length) == 2) {
+    string xml = gdb_target_xml();
+    if (offset >= xml.size()) {
+      return "l";
+    }
+    string part = xml.substr(offset, length);
+    return (offset + part.size() < xml.size() ? "m" : "l") + part;
+  }
+  return "";
+}
+
+// Responde a um pacote. A resposta vazia quer dizer nao suportado.
+//
+string gdb_command(GdbStub &s, Hart &h, const string &packet) {
+  const char *p = packet.c_str();
+  unsigned address, length, n;
+  switch (p[0]) {
+    case '?':
+      return s.stop;
+    case 'g': {
+      uint32_t regs[GDB_REGS];
+      for (int i = 0; i < GDB_REGS; i++) {
+        regs[i] = gdb_reg(h, i);
+      }
+      return gdb_hex(regs, sizeof(regs));
+    }
+    case 'G': {
+      uint32_t regs[GDB_REGS];
+      if (!gdb_unhex(p + 1, regs, sizeof(regs))) {
+        return "E01";
+      }
+      for (int i = 0; i < GDB_REGS; i++) {
+        gdb_set_reg(h, i, regs[i]);
+      }
+      return "OK";
+    }
+    case 'p': {
+      n = strtoul(p + 1, nullptr, 16);
+      if (n >= GDB_REGS) {
+        return "E01";
+      }
+      uint32_t value = gdb_reg(h, n);
+      return gdb_hex(&value, 4);
+    }
+    case 'P': {
+      uint32_t value;
+      const char *equal = strchr(p, '=');
+      n = strtoul(p + 1, nullptr, 16);
+      if (equal == nullptr || n >= GDB_REGS ||
+          !gdb_unhex(equal + 1, &value, 4)) {
+        return "E01";
+      }
+      gdb_set_reg(h, n, value);
+      return "OK";
+    }
+    case 'm': {
+      if (sscanf(p + 1, "%x,%x", &address, &length) != 2 ||
+          length > GDB_PACKET_SIZE / 2) {
+        return "E01";
+      }
+      vector<uint8_t> data(length);
+      if (!debug_read(h, address, data.data(), length)) {
+        return "E14";
+      }
+      return gdb_hex(data.data(), length);
+    }
+    case 'M': {
+      const char *colon = strchr(p, ':');
+      // o tamanho vem do GDB: so aloca o que os digitos recebidos cobrem
+      if (sscanf(p + 1, "%x,%x", &address, &length) != 2 ||
+          colon == nullptr || strlen(colon + 1) < 2 * (size_t)length) {
+        return "E01";
+      }
+      vector<uint8_t> data(length);
+      if (!gdb_unhex(colon + 1, data.data(), length)) {
+        return "E01";
+      }
+      return debug_write(h, address, data.data(), length) ? "OK" : "E14";
+    }
+    case 'c':
+    case 's':
+      if (p[1] != '\0') {
+        h.pc = strtoul(p + 1, nullptr, 16);
+      }
+      if (p[0] == 'c') {
+        return gdb_continue(s, h);
+      }
+      debug_resume(h, s.debugger, 1, false);
+      return gdb_stop(s, h, false);
+    case 'Z':
+    case 'z':
+      return gdb_point(s, h, p);
+    case 'q':
+      return gdb_query(p);
+    case 'H':
+    case 'T':
+      return "OK";  // uma thread so
+    case 'D':
+      s.detached = true;
+      return "OK";
+    default:
+      return "";
+  }
+}
+
+// Roda o programa ja carregado em h sob o GDB conectado em where. Devolve
+// -1 se a conexao nao abriu.
+//
+int run_gdb(Hart &h, const char *where) {
+  GdbStub s;
+  s.fd = gdb_accept(where);
+  if (s.fd < 0) {
+    return -1;
+  }
+  s.begin = s.end = 0;
+  s.stop = "S05";
+  s.fault_reported = false;
+  s.finished = false;
+  s.detached = false;
+  debug_start(h, s.debugger);
+  string packet;
+  while (!s.finished && !s.detached && gdb_read_packet(s, packet)) {
+    if (packet == "k") {
+      break;  // sem resposta
+    } else if (packet.compare(0, 5, "vKill") == 0) {
+      gdb_send(s, "OK");
+      break;
+    }
+    gdb_send(s, gdb_command(s, h, packet));
+  }
+  close(s.fd);
+  h.debugger = nullptr;
+  if (s.detached) {
+    h.resume_threaded();  // o programa continua sem o GDB
+    h.report_finish();
+  }
+  h.console.flush();
+  return 0;
+}
+
+#else
+
+int run_gdb(Hart &, const char *) {
+  printf("Servidor do GDB indisponivel neste sistema\n");
+  return -1;
+}
+
+#endif
@@ -26,6 +26,8 @@ enum OPCODES {
   StoreType = 0x23,  // store
   ILAType = 0x13,    // logico-aritmeticas com imediato
   RegType = 0x33,
+  FENCE = 0x0F,  // fence e fence.i
+  AMO = 0x2F,    // atomicas (extensao A)
   ECALL = 0x73
 };
 
@@ -61,7 +63,18 @@ enum FUNCT3 {
   SLTIU3 = 03,
   SLLI3 = 01,
   SRAI3 = 05,
-  SRI3 = 05
+  SRI3 = 05,
+  FENCE3 = 0,
+  FENCEI3 = 01,
+  MUL3 = 0,
+  MULH3 = 01,
+  MULHSU3 = 02,
+  MULHU3 = 03,
+  DIV3 = 04,
+  DIVU3 = 05,
+  REM3 = 06,
+  REMU3 = 07,
+  AMOW3 = 02
 };
 
 // FUNCT7: campo auxiliar na identificacao da instrucao
@@ -71,7 +84,23 @@ enum FUNCT7 {
   SRA7 = 0x20,
   SRL7 = 0,
   SRLI7 = 0x00,
-  SRAI7 = 0x20
+  SRAI7 = 0x20,
+  MULDIV7 = 0x01  // extensao M
+};
+
+// FUNCT5: bits 31:27 das instrucoes atomicas. Os bits 26:25 sao aq e rl.
+enum FUNCT5 {
+  AMOADD5 = 0x00,
+  AMOSWAP5 = 0x01,
+  LR5 = 0x02,
+  SC5 = 0x03,
+  AMOXOR5 = 0x04,
+  AMOOR5 = 0x08,
+  AMOAND5 = 0x0C,
+  AMOMIN5 = 0x10,
+  AMOMAX5 = 0x14,
+  AMOMINU5 = 0x18,
+  AMOMAXU5 = 0x1C
 };
 
 enum FORMATS {
@@ -124,7 +153,27 @@ enum INSTRUCTIONS {
   I_ori,
   I_ecall,
   I_xori,
-  I_nop
+  I_fence,
+  I_mul,
+  I_mulh,
+  I_mulhsu,
+  I_mulhu,
+  I_div,
+  I_divu,
+  I_rem,
+  I_remu,
+  I_lr_w,
+  I_sc_w,
+  I_amoswap_w,
+  I_amoadd_w,
+  I_amoxor_w,
+  I_amoand_w,
+  I_amoor_w,
+  I_amomin_w,
+  I_amomax_w,
+  I_amominu_w,
+  I_amomaxu_w,
+  I_nop  // instrucao invalida, sempre a ultima
 };
 
 //
@@ -165,6 +214,27 @@ enum REGISTERS {
   T6 = 31
 };
 
+//
+// Motivo do fim da execucao de um programa
+//
+enum EXIT_REASONS {
+  EXIT_RUNNING,      // ainda executando
+  EXIT_ECALL,        // ecall de saida
+  EXIT_DROPPED_OFF,  // PC saiu do segmento de texto
+  EXIT_LIMIT,        // atingiu o limite de instrucoes
+  EXIT_FAULT,        // acesso a endereco nao mapeado
+  EXIT_SNAPSHOT      // estado gravado pelo ecall de snapshot
+};
+
+const char *exit_str[] = {"running",           "exit",
+                          "dropped off bottom", "instruction limit",
+                          "memory fault",      "snapshot"};
+
+//
+// Motores de execucao disponiveis
+//
+enum ENGINES { E_SWITCH, E_THREADED, E_JIT };
+
 //
 // Memory
 //
@@ -188,88 +258,122 @@ enum WORD_SIZE_E {
 
 const WORD_SIZE_E WSIZE = WORD_SIZE;
 
-int32_t breg[32];  // banco de registradores
-
-uint32_t pc,  // contador de programa
-    ri,       // registrador de intrucao
-    sp,       // stack pointe4r
-    gp;       // global pointer
-
-int32_t imm32_t,  // imediato da instrucao
-    zero = 0,
-    imm12_i,  // constante 12 bits
-    imm12_s,  // constante 12 bits
-    imm13,    // constante 13 bits
-    imm20_u,  // constante 20 bis mais significativos
-    imm21;    // constante 21 bits
+// Imediato de cada instrucao, montado pelo decode a partir dos campos da
+// palavra
+enum IMMEDIATES {
+  IMM_NONE,   // tipo R, atomicas
+  IMM_I,      // 12 bits, 31:20
+  IMM_S,      // 12 bits, 31:25 e 11:7
+  IMM_B,      // 13 bits, sempre par
+  IMM_U,      // 20 bits mais significativos, ainda nao deslocados
+  IMM_J,      // 21 bits, sempre par
+  IMM_SHAMT   // deslocamento dos shifts com imediato, 24:20
+};
 
-uint32_t opcode,  // codigo da operacao
-    rs1,          // indice registrador rs
-    rs2,          // indice registrador rt
-    rd,           // indice registrador rd
-    shamt,        // deslocamento
-    funct3,       // campos auxiliares
-    funct7;       // constante instrucao tipo J
+// funct3 aceitos por uma instrucao, um bit por valor
+constexpr uint8_t F3(int funct3) { return 1 << funct3; }
+enum : uint8_t { F3_ANY = 0xFF };  // U e UJ: o campo faz parte do imediato
+enum : int16_t { F7_ANY = -1 };    // o campo faz parte do imediato
 
-int32_t *imediatos[] = {&zero,    &imm12_i, &imm12_s, &imm13,
-                        &imm20_u, &imm21,   &zero,    &zero};
+// Tudo o que o simulador sabe de uma instrucao: nome, formato, imediato e
+// encoding. As tabelas do decode (riscv.cpp) sao geradas daqui em tempo de
+// compilacao. Nas atomicas o funct7 guarda o funct5 (bits 31:27), ja que os
+// dois bits de baixo sao aq e rl.
+//
+struct InstrInfo {
+  INSTRUCTIONS id;  // a propria posicao na tabela, conferida abaixo
+  const char *name;
+  FORMATS format;
+  IMMEDIATES imm;
+  uint8_t opcode;
+  uint8_t funct3;  // F3() dos valores aceitos
+  int16_t funct7;
+};
 
-string instr_str[39];
+constexpr InstrInfo instr_info[I_nop + 1] = {
+    {I_add, "ADD", RType, IMM_NONE, RegType, F3(ADDSUB3), ADD7},
+    {I_addi, "ADDi", IType, IMM_I, ILAType, F3(ADDI3), F7_ANY},
+    {I_and, "AND", RType, IMM_NONE, RegType, F3(AND3), 0x00},
+    {I_andi, "ANDi", IType, IMM_I, ILAType, F3(ANDI3), F7_ANY},
+    {I_auipc, "AUIPC", UType, IMM_U, AUIPC, F3_ANY, F7_ANY},
+    {I_beq, "BEQ", SBType, IMM_B, BType, F3(BEQ3), F7_ANY},
+    {I_bge, "BGE", SBType, IMM_B, BType, F3(BGE3), F7_ANY},
+    {I_bgeu, "BGEU", SBType, IMM_B, BType, F3(BGEU3), F7_ANY},
+    {I_blt, "BLT", SBType, IMM_B, BType, F3(BLT3), F7_ANY},
+    {I_bltu, "BLTU", SBType, IMM_B, BType, F3(BLTU3), F7_ANY},
+    {I_bne, "BNE", SBType, IMM_B, BType, F3(BNE3), F7_ANY},
+    {I_jal, "JAL", UJType, IMM_J, JAL, F3_ANY, F7_ANY},
+    {I_jalr, "JALR", IType, IMM_I, JALR, F3(0), F7_ANY},
+    {I_lb, "LB", IType, IMM_I, ILType, F3(LB3), F7_ANY},
+    {I_lbu, "LBU", IType, IMM_I, ILType, F3(LBU3), F7_ANY},
+    {I_lw, "LW", IType, IMM_I, ILType, F3(LW3), F7_ANY},
+    {I_lh, "LH", IType, IMM_I, ILType, F3(LH3), F7_ANY},
+    {I_lhu, "LHU", IType, IMM_I, ILType, F3(LHU3), F7_ANY},
+    {I_lui, "LUI", UType, IMM_U, LUI, F3_ANY, F7_ANY},
+    {I_sb, "SB", SType, IMM_S, StoreType, F3(SB3), F7_ANY},
+    {I_sh, "SH", SType, IMM_S, StoreType, F3(SH3), F7_ANY},
+    {I_sw, "SW", SType, IMM_S, StoreType, F3(SW3), F7_ANY},
+    {I_sll, "SLL", RType, IMM_NONE, RegType, F3(SLL3), 0x00},
+    {I_slt, "SLT", RType, IMM_NONE, RegType, F3(SLT3), 0x00},
+    {I_slli, "SLLi", IType, IMM_SHAMT, ILAType, F3(SLLI3), 0x00},
+    {I_srl, "SRL", RType, IMM_NONE, RegType, F3(SR3), SRL7},
+    {I_sra, "SRA", RType, IMM_NONE, RegType, F3(SR3), SRA7},
+    {I_sub, "SUB", RType, IMM_NONE, RegType, F3(ADDSUB3), SUB7},
+    {I_slti, "SLTi", IType, IMM_I, ILAType, F3(SLTI3), F7_ANY},
+    {I_sltiu, "SLTIU", IType, IMM_I, ILAType, F3(SLTIU3), F7_ANY},
+    {I_xor, "XOR", RType, IMM_NONE, RegType, F3(XOR3), 0x00},
+    {I_or, "OR", RType, IMM_NONE, RegType, F3(OR3), 0x00},
+    {I_srli, "SRLi", IType, IMM_SHAMT, ILAType, F3(SRI3), SRLI7},
+    {I_srai, "SRAi", IType, IMM_SHAMT, ILAType, F3(SRI3), SRAI7},
+    {I_sltu, "SLTU", RType, IMM_NONE, RegType, F3(SLTU3), 0x00},
+    {I_ori, "ORi", IType, IMM_I, ILAType, F3(ORI3), F7_ANY},
+    {I_ecall, "ECALL", IType, IMM_I, ECALL, F3(0), F7_ANY},  // so 00000073
+    {I_xori, "XORi", IType, IMM_I, ILAType, F3(XORI3), F7_ANY},
+    {I_fence, "FENCE", IType, IMM_I, FENCE, F3(FENCE3) | F3(FENCEI3), F7_ANY},
+    {I_mul, "MUL", RType, IMM_NONE, RegType, F3(MUL3), MULDIV7},
+    {I_mulh, "MULH", RType, IMM_NONE, RegType, F3(MULH3), MULDIV7},
+    {I_mulhsu, "MULHSU", RType, IMM_NONE, RegType, F3(MULHSU3), MULDIV7},
+    {I_mulhu, "MULHU", RType, IMM_NONE, RegType, F3(MULHU3), MULDIV7},
+    {I_div, "DIV", RType, IMM_NONE, RegType, F3(DIV3), MULDIV7},
+    {I_divu, "DIVU", RType, IMM_NONE, RegType, F3(DIVU3), MULDIV7},
+    {I_rem, "REM", RType, IMM_NONE, RegType, F3(REM3), MULDIV7},
+    {I_remu, "REMU", RType, IMM_NONE, RegType, F3(REMU3), MULDIV7},
+    {I_lr_w, "LR.W", RType, IMM_NONE, AMO, F3(AMOW3), LR5},
+    {I_sc_w, "SC.W", RType, IMM_NONE, AMO, F3(AMOW3), SC5},
+    {I_amoswap_w, "AMOSWAP.W", RType, IMM_NONE, AMO, F3(AMOW3), AMOSWAP5},
+    {I_amoadd_w, "AMOADD.W", RType, IMM_NONE, AMO, F3(AMOW3), AMOADD5},
+    {I_amoxor_w, "AMOXOR.W", RType, IMM_NONE, AMO, F3(AMOW3), AMOXOR5},
+    {I_amoand_w, "AMOAND.W", RType, IMM_NONE, AMO, F3(AMOW3), AMOAND5},
+    {I_amoor_w, "AMOOR.W", RType, IMM_NONE, AMO, F3(AMOW3), AMOOR5},
+    {I_amomin_w, "AMOMIN.W", RType, IMM_NONE, AMO, F3(AMOW3), AMOMIN5},
+    {I_amomax_w, "AMOMAX.W", RType, IMM_NONE, AMO, F3(AMOW3), AMOMAX5},
+    {I_amominu_w, "AMOMINU.W", RType, IMM_NONE, AMO, F3(AMOW3), AMOMINU5},
+    {I_amomaxu_w, "AMOMAXU.W", RType, IMM_NONE, AMO, F3(AMOW3), AMOMAXU5},
+    {I_nop, "NOP", NOPType, IMM_NONE, 0, 0, 0},
+};
 
-void build_dic() {
-  instr_str[I_add] = "ADD";
-  instr_str[I_addi] = "ADDi";
-  instr_str[I_and] = "AND";
-  instr_str[I_andi] = "ANDi";
-  instr_str[I_auipc] = "AUIPC";
-  instr_str[I_beq] = "BEQ";
-  instr_str[I_bge] = "BGE";
-  instr_str[I_bgeu] = "BGEU";
-  instr_str[I_blt] = "BLT";
-  instr_str[I_bltu] = "BLTU";
-  instr_str[I_bne] = "BNE";
-  instr_str[I_jal] = "JAL";
-  instr_str[I_jalr] = "JALR";
-  instr_str[I_lb] = "LB";
-  instr_str[I_lbu] = "LBU";
-  instr_str[I_lh] = "LH";
-  instr_str[I_lhu] = "LHU";
-  instr_str[I_lui] = "LUI";
-  instr_str[I_lw] = "LW";
-  instr_str[I_or] = "OR";
-  instr_str[I_ori] = "ORi";
-  instr_str[I_sb] = "SB";
-  instr_str[I_sh] = "SH";
-  instr_str[I_sll] = "SLL";
-  instr_str[I_slt] = "SLT";
-  instr_str[I_slli] = "SLLi";
-  instr_str[I_slti] = "SLTi";
-  instr_str[I_sltiu] = "SLTIU";
-  instr_str[I_sltu] = "SLTU";
-  instr_str[I_srl] = "SRL";
-  instr_str[I_sra] = "SRA";
-  instr_str[I_srli] = "SRLi";
-  instr_str[I_srai] = "SRAi";
-  instr_str[I_sub] = "SUB";
-  instr_str[I_sw] = "SW";
-  instr_str[I_xor] = "XOR";
-  instr_str[I_xori] = "XORi";
-  instr_str[I_ecall] = "ECALL";
-  instr_str[I_nop] = "NOP";
+constexpr bool instr_info_in_order() {
+  for (int i = 0; i <= I_nop; i++) {
+    if (instr_info[i].id != i) {
+      return false;
+    }
+  }
+  return true;
 }
+static_assert(instr_info_in_order(),
+              "instr_info fora da ordem de INSTRUCTIONS");
 
-string iformat_str[8] = {"RType", "IType",  "SType",      "SBType",
-                         "UType", "UJType", "NullFormat", "NOPType"};
+const char *const iformat_str[8] = {"RType", "IType",  "SType",
+                                    "SBType", "UType", "UJType",
+                                    "NullFormat", "NOPType"};
 
 //
 // identificacao dos registradores do banco do RV32I
 //
-string reg_str[] = {"ZERO", "RA", "SP",  "GP",  "TP", "T0", "T1", "T2",
-                    "S0",   "S1", "A0",  "A1",  "A2", "A3", "A4", "A5",
-                    "A6",   "A7", "S2",  "S3",  "S4", "S5", "S6", "S7",
-                    "S8",   "S9", "S10", "S11", "T3", "T4", "T5", "T6"};
-
-bool has_jumped;
-bool stop_prg;
+const char *const reg_str[] = {
+    "ZERO", "RA", "SP",  "GP",  "TP", "T0", "T1", "T2",
+    "S0",   "S1", "A0",  "A1",  "A2", "A3", "A4", "A5",
+    "A6",   "A7", "S2",  "S3",  "S4", "S5", "S6", "S7",
+    "S8",   "S9", "S10", "S11", "T3", "T4", "T5", "T6"};
 
 #endif
@@ -0,0 +1,319 @@
+//
+//  hart.h
+//  RV32Ic++
+//
+//  Estado completo de um processador (hart): banco de registradores, PC,
+//  campos do decode, memoria e estado de execucao. Cada Hart e independente,
+//  entao varios programas podem rodar no mesmo processo, e varios Harts podem
+//  dividir a memoria de um programa (smp.cpp).
+//
+
+#ifndef __HART_H__
+#define __HART_H__
+
+class Hart;
+struct DecodedInstr;
+
+// Handler de uma instrucao no motor threaded (threaded.cpp)
+typedef void (*Handler)(Hart &h, const DecodedInstr &d);
+
+// Instrucao pre-decodificada. Guarda somente o que o execute() precisa: a
+// instrucao, os indices dos registradores e o unico imediato usado por ela.
+// O handler e usado pelo motor threaded, que pode trocar o de uma instrucao
+// pelo de um par fundido com a seguinte.
+//
+struct DecodedInstr {
+  Handler handler;
+  INSTRUCTIONS instruction;
+  uint8_t rd, rs1, rs2;
+  bool valid;
+  int32_t imm;
+  uint8_t size;  // 2 para as instrucoes comprimidas, senao 4
+  bool fused;    // o handler executa tambem a entrada seguinte
+};
+
+// Estado do JIT, definido em jit.cpp
+struct JitState;
+// Contadores do perfil, definidos em profile.cpp
+struct Profile;
+// Estado salvo de um hart, definido em snapshot.cpp
+struct Snapshot;
+// Gravador de trace, definido em trace.cpp
+struct Trace;
+// Modelo de cache, definido em cache.cpp
+struct CacheModel;
+// Modelo do pipeline, definido em pipeline.cpp
+struct Pipeline;
+// Grupo de harts que dividem a memoria, definido em smp.cpp
+struct Smp;
+// Depurador interativo, definido em debug.cpp
+struct Debugger;
+
+// Escrita na memoria guardada para a comparacao com a referencia
+// (lockstep.cpp). value ja vem cortado para size bytes.
+//
+struct StoreRecord {
+  uint32_t address, size, value;
+};
+
+// Arquivo aberto pelo ecall open. O nome e o modo ficam guardados para o
+// snapshot poder reabrir o arquivo.
+//
+struct OpenFile {
+  FILE *fptr;
+  string name;
+  string mode;
+};
+
+class Hart {
+ public:
+  int32_t breg[32];  // banco de registradores
+
+  uint32_t pc,  // contador de programa
+      ri,       // registrador de intrucao
+      entry,    // PC inicial
+      sp,       // stack pointer inicial
+      gp;       // global pointer inicial
+
+  int32_t imm32_t;  // imediato da instrucao (instr_imm)
+
+  uint32_t opcode,  // codigo da operacao
+      rs1,          // indice registrador rs
+      rs2,          // indice registrador rt
+      rd,           // indice registrador rd
+      shamt,        // deslocamento
+      funct3,       // campos auxiliares
+      funct7;       // constante instrucao tipo J
+
+  INSTRUCTIONS instruction;  // instrucao decodificada
+  uint32_t ilen;             // tamanho dela: 2 (comprimida) ou 4
+
+  bool has_jumped;
+  bool stop_prg;
+
+  uint64_t instret;        // instrucoes executadas
+  uint64_t instret_limit;  // para a execucao ao chegar neste numero
+  EXIT_REASONS exit_reason;
+  int32_t exit_code;  // codigo passado ao ecall de saida
+
+  // Saida dos ecalls e das mensagens de erro do programa
+  Console console;
+
+  Memory mem;  // memoria paginada do hart, propria ou dividida (smp.cpp)
+  uint32_t brk;  // fim do heap, movido pelo ecall sbrk
+
+  // Reserva feita pelo lr.w para o sc.w: endereco e valor lido
+  bool reserved;
+  uint32_t reserved_address;
+  int32_t reserved_value;
+
+  // Arquivos abertos pelo programa, indexados pelo descritor. 0, 1 e 2 sao a
+  // entrada e a saida do console e nunca sao abertos aqui.
+  vector<OpenFile> files;
+
+  // Snapshot de onde a memoria foi restaurada. As paginas dele continuam
+  // sendo usadas ate a primeira escrita, entao ele vive tanto quanto o hart.
+  shared_ptr<const Snapshot> origin;
+  // Se nao for vazio, o ecall de snapshot grava o estado neste arquivo e
+  // termina o programa
+  string snapshot_path;
+
+  // Segmento de texto: o programa so executa dentro de [text_start,
+  // text_start + text_size). A cache de instrucoes decodificadas cobre
+  // exatamente este intervalo, uma entrada por meia palavra, ja que com a
+  // extensao C as instrucoes podem comecar em qualquer endereco par.
+  uint32_t text_start, text_size;
+  vector<DecodedInstr> decoded_cache;
+  JitState *jit;
+  Profile *profile;  // perfil ligado se nao for nulo
+  Trace *trace;      // trace ligado se nao for nulo
+  CacheModel *cache;  // modelo de cache ligado se nao for nulo
+  Pipeline *pipeline;  // modelo do pipeline ligado se nao for nulo
+  // Se nao for nulo, cada escrita do programa na memoria e guardada aqui
+  // (ver lockstep.cpp)
+  vector<StoreRecord> *stores;
+  // Grupo do hart quando varios harts dividem a memoria (smp.cpp), senao
+  // nulo
+  Smp *smp;
+  // Depurador que controla o hart (debug.cpp), senao nulo
+  Debugger *debugger;
+
+  // Simbolos de funcao do ELF, por endereco
+  map<uint32_t, string> functions;
+
+  Hart();
+  ~Hart();
+
+  // riscv.cpp
+  void init();
+  void dump_breg(FILE *out = stdout);
+  int load_mem(const char *fn, uint32_t start);
+  void set_text(uint32_t start, uint32_t size);
+
+  // elf.cpp
+  bool load_elf(const char *fn);
+
+  // riscv.cpp
+  FORMATS get_i_format(uint32_t opcode);
+  INSTRUCTIONS get_instr_code(uint32_t word);
+  void invalidate_decoded(uint32_t address);
+  void invalidate_decoded(uint32_t address, uint32_t size);
+  void clear_decoded();
+  uint32_t read_instr(uint32_t address, uint32_t &size);
+  void fetch();
+  void decode();
+  void execute();
+  void fetch_decoded();
+  void step();
+  void retire();
+  void report_finish();
+  void run();
+  void resume();
+  ENGINES start_engine(ENGINES engine);
+  void resume_engine(ENGINES engine);
+  void print(const char *text) { console.put(text); }
+
+  bool in_text(uint32_t address) { return address - text_start < text_size; }
+
+  // Entrada da cache para um endereco do segmento de texto
+  DecodedInstr &decoded(uint32_t address) {
+    return decoded_cache[(address - text_start) >> 1];
+  }
+
+  // Condicao de parada comum a todos os motores
+  bool running() {
+    return in_text(pc) && !stop_prg && !mem.fault && instret < instret_limit;
+  }
+
+  // threaded.cpp
+  void run_threaded();
+  void resume_threaded();
+
+  // jit.cpp
+  bool start_jit();
+  void run_jit();
+  void resume_jit();
+
+  // profile.cpp
+  void run_profiled();
+
+  // trace.cpp
+  void run_traced();
+
+  // cache.cpp
+  void run_cached();
+
+  // pipeline.cpp
+  void run_pipelined();
+
+  // snapshot.cpp
+  void restore(shared_ptr<const Snapshot> snapshot, int32_t variant);
+
+  // Acesso a memoria do hart (acessoMemoriaRV.c). Uma falta para a execucao
+  // pelo running(), com o PC na instrucao que fez o acesso.
+  int32_t lw(uint32_t address, int32_t kte) { return ::lw(&mem, address, kte); }
+  int32_t lb(uint32_t address, int32_t kte) { return ::lb(&mem, address, kte); }
+  int32_t lbu(uint32_t address, int32_t kte) {
+    return ::lbu(&mem, address, kte);
+  }
+  void sw(uint32_t address, int32_t kte, int32_t dado) {
+    ::sw(&mem, address, kte, dado);
+    invalidate_store(address + kte, 4);
+    log_store(address + kte, 4, dado);
+  }
+  void sb(uint32_t address, int32_t kte, int8_t dado) {
+    ::sb(&mem, address, kte, dado);
+    invalidate_decoded(address + kte);
+    log_store(address + kte, 1, (uint8_t)dado);
+  }
+  int32_t lh(uint32_t address, int32_t kte) { return ::lh(&mem, address, kte); }
+  int32_t lhu(uint32_t address, int32_t kte) {
+    return ::lhu(&mem, address, kte);
+  }
+  void sh(uint32_t address, int32_t kte, int16_t dado) {
+    ::sh(&mem, address, kte, dado);
+    invalidate_store(address + kte, 2);
+    log_store(address + kte, 2, (uint16_t)dado);
+  }
+  // Copias em bloco usadas pelos ecalls (syscalls.cpp)
+  bool read_bytes(uint32_t address, void *dst, uint32_t n) {
+    return mem_read_bytes(&mem, address, dst, n);
+  }
+  bool write_bytes(uint32_t address, const void *src, uint32_t n) {
+    bool ok = mem_write_bytes(&mem, address, src, n);
+    invalidate_decoded(address, n);
+    for (uint32_t i = 0; stores != nullptr && i < n; i++) {
+      stores->push_back(
+          StoreRecord{address + i, 1, static_cast<const uint8_t *>(src)[i]});
+    }
+    return ok;
+  }
+  // Invalida a cache de instrucoes nas palavras escritas por um store de
+  // size bytes, que pode estar desalinhado e tocar duas palavras
+  void invalidate_store(uint32_t address, uint32_t size) {
+    invalidate_decoded(address);
+    if ((address & 3) + size > 4) {
+      invalidate_decoded(address + size - 1);
+    }
+  }
+  void log_store(uint32_t address, uint32_t size, uint32_t value) {
+    if (stores != nullptr && !mem.fault) {
+      stores->push_back(StoreRecord{address, size, value});
+    }
+  }
+
+  // Instrucoes (riscvcommands.cpp)
+  int32_t rADD(int output, int input1, int input2);
+  int32_t iADDI(int output, int input1, int32_t immediate);
+  int32_t rAND(int output, int input1, int input2);
+  int32_t iANDI(int output, int input1, int32_t immediate);
+  uint32_t uAUIPC(int output, uint32_t immediate);
+  void sbBEQ(int input1, int input2, int label);
+  void sbBNE(int input1, int input2, int label);
+  void sbBGE(int input1, int input2, int label);
+  void sbBGEU(int input1, int input2, int label);
+  void sbBLT(int input1, int input2, int label);
+  void sbBLTU(int input1, int input2, int label);
+  void ujJAL(int link, int target);
+  void ujJALR(int link, int target, int immediate);
+  int32_t iLB(int output, uint32_t address, int32_t kte);
+  int32_t rOR(int output, int input1, int input2);
+  int32_t iLBU(int output, uint32_t address, int32_t kte);
+  int32_t iLW(int output, uint32_t address, int32_t kte);
+  int32_t uLUI(int output, int immediate);
+  void pseudoNOP();
+  int32_t rSLTU(int output, int input1, int input2);
+  int32_t iORI(int output, int input1, int immediate);
+  void sSB(uint32_t address, int32_t dado, int32_t kte);
+  int32_t iSLLI(int output, int input1, int immediate);
+  int32_t rSLT(int output, int input1, int input2);
+  int32_t iSRAI(int output, int input1, int immediate);
+  int32_t iSRLI(int output, int input1, int immediate);
+  int32_t rSUB(int output, int input1, int input2);
+  void sSW(uint32_t address, int32_t dado, int32_t kte);
+  int32_t rXOR(int output, int input1, int input2);
+  int32_t iLH(int output, uint32_t address, int32_t kte);
+  int32_t iLHU(int output, uint32_t address, int32_t kte);
+  void sSH(uint32_t address, int32_t dado, int32_t kte);
+  int32_t iSLTI(int output, int input1, int32_t immediate);
+  int32_t iSLTIU(int output, int input1, int32_t immediate);
+  int32_t iXORI(int output, int input1, int32_t immediate);
+  int32_t rSLL(int output, int input1, int input2);
+  int32_t rSRL(int output, int input1, int input2);
+  int32_t rSRA(int output, int input1, int input2);
+  void iFENCE();
+  int32_t rMUL(int output, int input1, int input2);
+  int32_t rMULH(int output, int input1, int input2);
+  int32_t rMULHSU(int output, int input1, int input2);
+  int32_t rMULHU(int output, int input1, int input2);
+  int32_t rDIV(int output, int input1, int input2);
+  int32_t rDIVU(int output, int input1, int input2);
+  int32_t rREM(int output, int input1, int input2);
+  int32_t rREMU(int output, int input1, int input2);
+  int32_t rLRW(int output, int address);
+  int32_t rSCW(int output, int address, int input);
+  int32_t rAMOW(INSTRUCTIONS operation, int output, int address, int input);
+  bool sysECALL();
+};
+
+#endif
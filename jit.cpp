@@ -0,0 +1,776 @@
+/*
+ *  jit.cpp
+ *
+ * Tradutor de blocos basicos RV32IM -> x86-64.
+ *
+ * Um bloco comeca em qualquer PC e vai ate a primeira instrucao de desvio
+ * (BType, JAL, JALR), que e traduzida junto, ou ate uma instrucao que o JIT nao
+ * traduz (ECALL, atomicas, instrucoes invalidas), que fica para o
+ * interpretador. O codigo gerado recebe o endereco de breg em rdi e o Hart em
+ * rsi, mantem os dois fixos em rbx e r12 durante o bloco e devolve o proximo
+ * PC em eax. Os registradores do RISC-V nao sao copiados para registradores
+ * do host: cada operando e lido e escrito direto no breg, que fica no L1,
+ * entao o breg esta certo em toda saida de bloco e em toda chamada para as
+ * funcoes do interpretador.
+ *
+ * Os blocos ficam numa cache indexada por PC. Quando o destino de um desvio ja
+ * foi traduzido, o bloco salta direto para ele sem voltar ao laco principal.
+ * Um PC cuja primeira instrucao nao e traduzida (todo ECALL) fica marcado e
+ * vai direto para o handler, sem tentar traduzir de novo a cada visita.
+ * Qualquer escrita (sw/sh/sb) numa palavra ja traduzida descarta a cache
+ * inteira. As divisoes e as partes altas das multiplicacoes chamam as mesmas
+ * funcoes do interpretador (rv_div etc.).
+ *
+ * Em maquinas que nao sao x86-64 o JIT cai no motor threaded.
+ */
+
+#if defined(__x86_64__) && defined(__unix__)
+
+#include <sys/mman.h>
+
+#include <algorithm>
+
+typedef uint32_t (*JitEntry)(int32_t *regs, Hart *h);
+
+enum { JIT_CODE_SIZE = 1 << 20 };        // 1 MiB de codigo gerado
+enum { JIT_BLOCK_MAX = 64 };             // instrucoes por bloco
+enum { JIT_PROLOGUE_SIZE = 13 };         // ver jit_translate()
+
+// Bytes gerados pelas sequencias mais longas do JitEmitter, para o pior caso
+// de um bloco. Quem mudar uma delas tem que mudar o tamanho aqui; se ficar
+// pequeno, o bloco nao cabe, o buffer e descartado e o bloco e gerado de
+// novo, mais cedo do que precisava.
+enum {
+  JIT_COUNT_SIZE = 14,        // count()
+  JIT_EXIT_DYNAMIC_SIZE = 8,  // exit_dynamic()
+  // exit_if(): mov, cmp e je; count(); mov eax; exit_dynamic()
+  JIT_EXIT_IF_SIZE = 19 + JIT_COUNT_SIZE + 5 + JIT_EXIT_DYNAMIC_SIZE,
+  // exit(): count(); salto para o bloco ja traduzido; mov eax; exit_dynamic()
+  JIT_EXIT_SIZE = JIT_COUNT_SIZE + 42 + 5 + JIT_EXIT_DYNAMIC_SIZE,
+  // load(): argumentos e call; a saida da falta; store_reg()
+  JIT_LOAD_SIZE = 23 + JIT_EXIT_IF_SIZE + 3,
+  // store(): argumentos e call; as saidas da falta e do codigo sobrescrito
+  JIT_STORE_SIZE = 26 + 2 * JIT_EXIT_IF_SIZE,
+  // branch(): cmp e jcc; as saidas do desvio tomado e nao tomado
+  JIT_BRANCH_SIZE = 12 + 2 * JIT_EXIT_SIZE,
+};
+static_assert(JIT_LOAD_SIZE == 72 && JIT_STORE_SIZE == 118 &&
+                  JIT_BRANCH_SIZE == 150,
+              "tamanhos das sequencias do JitEmitter");
+
+// Pior caso de um bloco: o prologo, JIT_BLOCK_MAX instrucoes da maior
+// sequencia e a saida do fim do bloco
+enum {
+  JIT_INSTR_MAX_SIZE =
+      JIT_BRANCH_SIZE > JIT_STORE_SIZE ? JIT_BRANCH_SIZE : JIT_STORE_SIZE,
+  JIT_BLOCK_MAX_BYTES =
+      JIT_PROLOGUE_SIZE + JIT_BLOCK_MAX * JIT_INSTR_MAX_SIZE + JIT_EXIT_SIZE
+};
+
+// Estado do JIT de um hart. O codigo gerado referencia os campos deste
+// estado por endereco absoluto, entao cada hart tem o seu.
+//
+// As tabelas cobrem o segmento de texto do hart, uma entrada por meia palavra
+// (com a extensao C uma instrucao pode comecar em qualquer endereco par).
+//
+struct JitState {
+  uint8_t *code;  // buffer executavel
+  size_t used;    // bytes ja usados no buffer
+  vector<JitEntry> blocks;      // bloco que comeca em cada PC
+  vector<uint8_t> translated;   // uma instrucao de um bloco comeca aqui
+  vector<uint8_t> interpreted;  // a instrucao daqui nao abre bloco
+  bool flush_pending;  // alguma instrucao traduzida foi sobrescrita
+};
+
+// Registradores x86 usados pelo gerador
+//
+enum X86_REGS { EAX = 0, ECX = 1, EDX = 2, ESI = 6, EDI = 7 };
+
+/******************************** TRAMPOLINS *********************************/
+
+// O codigo gerado nao chama metodos do Hart direto, passa por estas funcoes
+
+int32_t jit_lw(Hart *h, uint32_t address, int32_t kte) {
+  return h->lw(address, kte);
+}
+
+int32_t jit_lb(Hart *h, uint32_t address, int32_t kte) {
+  return h->lb(address, kte);
+}
+
+int32_t jit_lbu(Hart *h, uint32_t address, int32_t kte) {
+  return h->lbu(address, kte);
+}
+
+int32_t jit_lh(Hart *h, uint32_t address, int32_t kte) {
+  return h->lh(address, kte);
+}
+
+int32_t jit_lhu(Hart *h, uint32_t address, int32_t kte) {
+  return h->lhu(address, kte);
+}
+
+void jit_sw(Hart *h, uint32_t address, int32_t kte, int32_t dado) {
+  h->sw(address, kte, dado);
+}
+
+void jit_sb(Hart *h, uint32_t address, int32_t kte, int32_t dado) {
+  h->sb(address, kte, dado & BYTE1AND);
+}
+
+void jit_sh(Hart *h, uint32_t address, int32_t kte, int32_t dado) {
+  h->sh(address, kte, dado & 0xFFFF);
+}
+
+/********************************** EMISSAO **********************************/
+
+// Gerador de codigo de um bloco
+//
+class JitEmitter {
+ public:
+  JitEmitter(JitState *jit, Hart *hart)
+      : retired(0), overflow(false), j(jit), h(hart) {}
+
+  int retired;    // instrucoes do bloco executadas ate o ponto atual
+  bool overflow;  // o bloco nao coube no buffer e nao pode ser usado
+
+  void emit8(uint8_t byte) {
+    if (room(1)) {
+      j->code[j->used++] = byte;
+    }
+  }
+
+  void emit32(uint32_t value) {
+    if (room(4)) {
+      memcpy(j->code + j->used, &value, 4);
+      j->used += 4;
+    }
+  }
+
+  void emit64(uint64_t value) {
+    if (room(8)) {
+      memcpy(j->code + j->used, &value, 8);
+      j->used += 8;
+    }
+  }
+
+  // Reserva um rel32 para ser preenchido por patch()
+  size_t jump_slot() {
+    size_t slot = j->used;
+    emit32(0);
+    return slot;
+  }
+
+  // Faz o rel32 reservado apontar para a posicao atual
+  void patch(size_t slot) {
+    if (overflow) {
+      return;  // o slot pode ter ficado fora do buffer
+    }
+    uint32_t rel = j->used - (slot + 4);
+    memcpy(j->code + slot, &rel, 4);
+  }
+
+  // mov reg, [rbx + 4 * r]
+  void load_reg(X86_REGS reg, uint32_t r) {
+    emit8(0x8B);
+    emit8(0x43 | (reg << 3));
+    emit8(r * 4);
+  }
+
+  // mov [rbx + 4 * rd], eax
+  void store_reg(uint32_t rd) {
+    if (rd == ZERO) {
+      return;
+    }
+    emit8(0x89);
+    emit8(0x43);
+    emit8(rd * 4);
+  }
+
+  // mov dword [rbx + 4 * rd], value
+  void store_const(uint32_t rd, uint32_t value) {
+    if (rd == ZERO) {
+      return;
+    }
+    emit8(0xC7);
+    emit8(0x43);
+    emit8(rd * 4);
+    emit32(value);
+  }
+
+  // <op> eax, [rbx + 4 * r]
+  void alu_reg(uint8_t op, uint32_t r) {
+    emit8(op);
+    emit8(0x43);
+    emit8(r * 4);
+  }
+
+  // setcc al; movzx eax, al
+  void set(uint8_t setcc) {
+    emit8(0x0F);
+    emit8(setcc);
+    emit8(0xC0);
+    emit8(0x0F);
+    emit8(0xB6);
+    emit8(0xC0);
+  }
+
+  // mov rax, function; call rax
+  void call(const void *function) {
+    emit8(0x48);
+    emit8(0xB8);
+    emit64(reinterpret_cast<uint64_t>(function));
+    emit8(0xFF);
+    emit8(0xD0);
+  }
+
+  // Operacao com os dois registradores feita por uma funcao:
+  // breg[rd] = funcao(breg[rs1], breg[rs2])
+  void call_binary(const DecodedInstr &d, const void *function) {
+    load_reg(EDI, d.rs1);
+    load_reg(ESI, d.rs2);
+    call(function);
+    store_reg(d.rd);
+  }
+
+  // Shift pelo registrador: o x86 tambem so usa os 5 bits de baixo de cl
+  void shift_reg(const DecodedInstr &d, uint8_t op) {
+    load_reg(EAX, d.rs1);
+    load_reg(ECX, d.rs2);
+    emit8(0xD3);
+    emit8(op);
+    store_reg(d.rd);
+  }
+
+  // push rbx; push r12; sub rsp, 8; mov rbx, rdi; mov r12, rsi
+  void prologue() {
+    emit8(0x53);
+    emit8(0x41);
+    emit8(0x54);
+    emit8(0x48);
+    emit8(0x83);
+    emit8(0xEC);
+    emit8(0x08);
+    emit8(0x48);
+    emit8(0x89);
+    emit8(0xFB);
+    emit8(0x49);
+    emit8(0x89);
+    emit8(0xF4);
+  }
+
+  // Soma as instrucoes executadas no bloco ao instret do hart
+  // mov rcx, &instret; add qword [rcx], retired
+  void count() {
+    emit8(0x48);
+    emit8(0xB9);
+    emit64(reinterpret_cast<uint64_t>(&h->instret));
+    emit8(0x48);
+    emit8(0x83);
+    emit8(0x01);
+    emit8(retired);
+  }
+
+  // Saida com o PC ja calculado em eax
+  // add rsp, 8; pop r12; pop rbx; ret
+  void exit_dynamic() {
+    emit8(0x48);
+    emit8(0x83);
+    emit8(0xC4);
+    emit8(0x08);
+    emit8(0x41);
+    emit8(0x5C);
+    emit8(0x5B);
+    emit8(0xC3);
+  }
+
+  // Saida do bloco para um PC conhecido. Se o destino ja estiver traduzido
+  // e o limite de instrucoes nao foi atingido, salta direto para o corpo dele
+  // (depois do prologo), senao devolve o PC.
+  void exit(uint32_t target) {
+    count();
+    if (h->in_text(target) && (target & 1) == 0) {
+      emit8(0x48);  // mov rax, &instret_limit
+      emit8(0xB8);
+      emit64(reinterpret_cast<uint64_t>(&h->instret_limit));
+      emit8(0x48);  // mov rax, [rax]
+      emit8(0x8B);
+      emit8(0x00);
+      emit8(0x48);  // cmp [rcx], rax
+      emit8(0x39);
+      emit8(0x01);
+      emit8(0x73);  // jae +24
+      emit8(0x18);
+      emit8(0x48);  // mov rax, &blocks[target]
+      emit8(0xB8);
+      emit64(reinterpret_cast<uint64_t>(
+          &j->blocks[(target - h->text_start) >> 1]));
+      emit8(0x48);  // mov rax, [rax]
+      emit8(0x8B);
+      emit8(0x00);
+      emit8(0x48);  // test rax, rax
+      emit8(0x85);
+      emit8(0xC0);
+      emit8(0x74);  // jz +6
+      emit8(0x06);
+      emit8(0x48);  // add rax, JIT_PROLOGUE_SIZE
+      emit8(0x83);
+      emit8(0xC0);
+      emit8(JIT_PROLOGUE_SIZE);
+      emit8(0xFF);  // jmp rax
+      emit8(0xE0);
+    }
+    emit8(0xB8);  // mov eax, target
+    emit32(target);
+    exit_dynamic();
+  }
+
+  // Sai do bloco devolvendo pc se o byte flag nao for zero. Usado depois dos
+  // acessos a memoria: falta (sai na propria instrucao) e store que
+  // sobrescreveu codigo traduzido (sai na seguinte). Quando continua o bloco
+  // so muda rcx, entao o valor de um load ainda esta em eax.
+  void exit_if(const bool *flag, uint32_t pc) {
+    emit8(0x48);  // mov rcx, flag
+    emit8(0xB9);
+    emit64(reinterpret_cast<uint64_t>(flag));
+    emit8(0x80);  // cmp byte [rcx], 0
+    emit8(0x39);
+    emit8(0x00);
+    emit8(0x0F);  // je rel32 (continua o bloco)
+    emit8(0x84);
+    size_t slot = jump_slot();
+    count();
+    emit8(0xB8);  // mov eax, pc
+    emit32(pc);
+    exit_dynamic();
+    patch(slot);
+  }
+
+  // Desvio condicional: jcc para a saida do desvio tomado. JIT_BRANCH_SIZE
+  // bytes.
+  void branch(const DecodedInstr &d, uint32_t address, uint8_t jcc) {
+    load_reg(EAX, d.rs1);
+    alu_reg(0x3B, d.rs2);  // cmp eax, [rs2]
+    emit8(0x0F);
+    emit8(jcc);
+    size_t slot = jump_slot();
+    exit(address + d.size);
+    patch(slot);
+    exit(address + d.imm);
+  }
+
+  // Load: eax = funcao(hart, breg[rs1], imm). Com falta rd nao muda.
+  // JIT_LOAD_SIZE bytes.
+  void load(const DecodedInstr &d, const void *function, uint32_t address) {
+    emit8(0x4C);  // mov rdi, r12
+    emit8(0x89);
+    emit8(0xE7);
+    load_reg(ESI, d.rs1);
+    emit8(0xBA);  // mov edx, imm
+    emit32(d.imm);
+    call(function);
+    exit_if(&h->mem.fault, address);
+    store_reg(d.rd);
+  }
+
+  // Store: funcao(hart, breg[rs1], imm, breg[rs2]). JIT_STORE_SIZE bytes.
+  void store(const DecodedInstr &d, const void *function, uint32_t address) {
+    emit8(0x4C);  // mov rdi, r12
+    emit8(0x89);
+    emit8(0xE7);
+    load_reg(ESI, d.rs1);
+    emit8(0xBA);  // mov edx, imm
+    emit32(d.imm);
+    load_reg(ECX, d.rs2);
+    call(function);
+    exit_if(&h->mem.fault, address);
+    exit_if(&j->flush_pending, address + d.size);
+  }
+
+ private:
+  JitState *j;
+  Hart *h;
+
+  // Confere se ainda cabem n bytes no buffer, senao marca o overflow
+  bool room(size_t n) {
+    if (j->used + n > JIT_CODE_SIZE) {
+      overflow = true;
+    }
+    return !overflow;
+  }
+};
+
+/********************************* TRADUCAO **********************************/
+
+enum JIT_RESULT { JIT_NEXT, JIT_END, JIT_UNSUPPORTED };
+
+JIT_RESULT jit_translate_one(JitEmitter &e, const DecodedInstr &d,
+                             uint32_t address) {
+  switch (d.instruction) {
+    case I_add:
+      e.load_reg(EAX, d.rs1);
+      e.alu_reg(0x03, d.rs2);
+      e.store_reg(d.rd);
+      return JIT_NEXT;
+    case I_sub:
+      e.load_reg(EAX, d.rs1);
+      e.alu_reg(0x2B, d.rs2);
+      e.store_reg(d.rd);
+      return JIT_NEXT;
+    case I_and:
+      e.load_reg(EAX, d.rs1);
+      e.alu_reg(0x23, d.rs2);
+      e.store_reg(d.rd);
+      return JIT_NEXT;
+    case I_or:
+      e.load_reg(EAX, d.rs1);
+      e.alu_reg(0x0B, d.rs2);
+      e.store_reg(d.rd);
+      return JIT_NEXT;
+    case I_xor:
+      e.load_reg(EAX, d.rs1);
+      e.alu_reg(0x33, d.rs2);
+      e.store_reg(d.rd);
+      return JIT_NEXT;
+    case I_slt:
+    case I_sltu:
+      e.load_reg(EAX, d.rs1);
+      e.alu_reg(0x3B, d.rs2);                            // cmp eax, [rs2]
+      e.set(d.instruction == I_slt ? 0x9C : 0x92);  // setl / setb
+      e.store_reg(d.rd);
+      return JIT_NEXT;
+    case I_slti:
+    case I_sltiu:
+      e.load_reg(EAX, d.rs1);
+      e.emit8(0x3D);  // cmp eax, imm
+      e.emit32(d.imm);
+      e.set(d.instruction == I_slti ? 0x9C : 0x92);  // setl / setb
+      e.store_reg(d.rd);
+      return JIT_NEXT;
+    case I_addi:
+    case I_andi:
+    case I_ori:
+    case I_xori:
+      e.load_reg(EAX, d.rs1);
+      e.emit8(d.instruction == I_addi   ? 0x05    // add eax, imm
+              : d.instruction == I_andi ? 0x25    // and eax, imm
+              : d.instruction == I_ori  ? 0x0D    // or eax, imm
+                                        : 0x35);  // xor eax, imm
+      e.emit32(d.imm);
+      e.store_reg(d.rd);
+      return JIT_NEXT;
+    case I_slli:
+    case I_srli:
+    case I_srai:
+      e.load_reg(EAX, d.rs1);
+      e.emit8(0xC1);
+      e.emit8(d.instruction == I_slli   ? 0xE0    // shl eax, imm
+              : d.instruction == I_srli ? 0xE8    // shr eax, imm
+                                        : 0xF8);  // sar eax, imm
+      e.emit8(d.imm);
+      e.store_reg(d.rd);
+      return JIT_NEXT;
+    case I_sll:
+      e.shift_reg(d, 0xE0);  // shl eax, cl
+      return JIT_NEXT;
+    case I_srl:
+      e.shift_reg(d, 0xE8);  // shr eax, cl
+      return JIT_NEXT;
+    case I_sra:
+      e.shift_reg(d, 0xF8);  // sar eax, cl
+      return JIT_NEXT;
+    case I_mul:
+      e.load_reg(EAX, d.rs1);
+      e.emit8(0x0F);  // imul eax, [rs2]
+      e.emit8(0xAF);
+      e.emit8(0x43);
+      e.emit8(d.rs2 * 4);
+      e.store_reg(d.rd);
+      return JIT_NEXT;
+    case I_mulh:
+      e.call_binary(d, reinterpret_cast<const void *>(&rv_mulh));
+      return JIT_NEXT;
+    case I_mulhsu:
+      e.call_binary(d, reinterpret_cast<const void *>(&rv_mulhsu));
+      return JIT_NEXT;
+    case I_mulhu:
+      e.call_binary(d, reinterpret_cast<const void *>(&rv_mulhu));
+      return JIT_NEXT;
+    case I_div:
+      e.call_binary(d, reinterpret_cast<const void *>(&rv_div));
+      return JIT_NEXT;
+    case I_divu:
+      e.call_binary(d, reinterpret_cast<const void *>(&rv_divu));
+      return JIT_NEXT;
+    case I_rem:
+      e.call_binary(d, reinterpret_cast<const void *>(&rv_rem));
+      return JIT_NEXT;
+    case I_remu:
+      e.call_binary(d, reinterpret_cast<const void *>(&rv_remu));
+      return JIT_NEXT;
+    case I_fence:
+      e.emit8(0x0F);  // mfence
+      e.emit8(0xAE);
+      e.emit8(0xF0);
+      return JIT_NEXT;
+    case I_lui:
+      e.store_const(d.rd, d.imm << 12);
+      return JIT_NEXT;
+    case I_auipc:
+      e.store_const(d.rd, address + (d.imm << 12));
+      return JIT_NEXT;
+    case I_lw:
+      e.load(d, reinterpret_cast<const void *>(&jit_lw), address);
+      return JIT_NEXT;
+    case I_lb:
+      e.load(d, reinterpret_cast<const void *>(&jit_lb), address);
+      return JIT_NEXT;
+    case I_lbu:
+      e.load(d, reinterpret_cast<const void *>(&jit_lbu), address);
+      return JIT_NEXT;
+    case I_lh:
+      e.load(d, reinterpret_cast<const void *>(&jit_lh), address);
+      return JIT_NEXT;
+    case I_lhu:
+      e.load(d, reinterpret_cast<const void *>(&jit_lhu), address);
+      return JIT_NEXT;
+    case I_sw:
+      e.store(d, reinterpret_cast<const void *>(&jit_sw), address);
+      return JIT_NEXT;
+    case I_sb:
+      e.store(d, reinterpret_cast<const void *>(&jit_sb), address);
+      return JIT_NEXT;
+    case I_sh:
+      e.store(d, reinterpret_cast<const void *>(&jit_sh), address);
+      return JIT_NEXT;
+    case I_beq:
+      e.branch(d, address, 0x84);  // je
+      return JIT_END;
+    case I_bne:
+      e.branch(d, address, 0x85);  // jne
+      return JIT_END;
+    case I_blt:
+      e.branch(d, address, 0x8C);  // jl
+      return JIT_END;
+    case I_bge:
+      e.branch(d, address, 0x8D);  // jge
+      return JIT_END;
+    case I_bltu:
+      e.branch(d, address, 0x82);  // jb
+      return JIT_END;
+    case I_bgeu:
+      e.branch(d, address, 0x83);  // jae
+      return JIT_END;
+    case I_jal:
+      e.store_const(d.rd, address + d.size);
+      e.exit(address + d.imm);
+      return JIT_END;
+    case I_jalr:
+      e.load_reg(EAX, d.rs1);
+      e.emit8(0x05);  // add eax, imm
+      e.emit32(d.imm);
+      e.emit8(0x83);  // and eax, -2
+      e.emit8(0xE0);
+      e.emit8(0xFE);
+      e.store_const(d.rd, address + d.size);
+      e.count();
+      e.exit_dynamic();
+      return JIT_END;
+    default:
+      return JIT_UNSUPPORTED;
+  }
+}
+
+// Descarta todos os blocos. O tamanho das tabelas nao muda, entao os
+// enderecos delas usados pelo codigo gerado continuam validos.
+//
+void jit_flush(JitState *jit) {
+  jit->used = 0;
+  jit->flush_pending = false;
+  fill(jit->blocks.begin(), jit->blocks.end(), nullptr);
+  fill(jit->translated.begin(), jit->translated.end(), 0);
+  fill(jit->interpreted.begin(), jit->interpreted.end(), 0);
+}
+
+// Chamado pelo invalidate_decoded() a cada escrita no segmento de texto, com o
+// indice de cada meia palavra afetada
+//
+void jit_invalidate(JitState *jit, uint32_t index) {
+  if (jit->translated[index]) {
+    jit->flush_pending = true;
+  }
+  jit->interpreted[index] = 0;  // a instrucao nova pode ser traduzivel
+}
+
+void jit_release(JitState *jit) {
+  if (jit != nullptr) {
+    munmap(jit->code, JIT_CODE_SIZE);
+    delete jit;
+  }
+}
+
+// Decodifica a instrucao em address usando a cache do interpretador
+//
+const DecodedInstr &jit_decode_at(Hart &h, uint32_t address) {
+  uint32_t saved_pc = h.pc;  // fetch() e decode() trabalham sobre o pc
+  h.pc = address;
+  h.fetch_decoded();
+  h.pc = saved_pc;
+  return h.decoded(address);
+}
+
+// Gera o bloco que comeca em start a partir da posicao atual do buffer.
+// Devolve nullptr se a primeira instrucao nao puder ser traduzida, e marca
+// start para nao tentar de novo ate uma escrita nela. Se o bloco nao coube
+// no buffer, nada e gerado e overflow fica true.
+//
+JitEntry jit_emit_block(Hart &h, uint32_t start, bool &overflow) {
+  JitState *jit = h.jit;
+  JitEmitter e(jit, &h);
+  size_t begin = jit->used;
+  e.prologue();
+
+  uint32_t address = start;
+  int count = 0;
+  JIT_RESULT result = JIT_NEXT;
+  while (count < JIT_BLOCK_MAX && h.in_text(address)) {
+    // so decodifica instrucoes validas, para nao imprimir o erro de
+    // instrucao invalida durante a traducao
+    uint32_t size;
+    if (!mem_mapped(&h.mem, address) || !mem_mapped(&h.mem, address + 2) ||
+        decode_lookup(h.read_instr(address, size)) == I_nop) {
+      break;
+    }
+    const DecodedInstr &d = jit_decode_at(h, address);
+    if (!d.valid) {
+      break;
+    }
+    size_t before = jit->used;
+    e.retired = count + 1;
+    result = jit_translate_one(e, d, address);
+    if (result == JIT_UNSUPPORTED) {
+      jit->used = before;
+      break;
+    }
+    jit->translated[(address - h.text_start) >> 1] = 1;
+    count++;
+    if (result == JIT_END) {
+      break;
+    }
+    address += d.size;
+  }
+  if (result != JIT_END && count > 0) {
+    e.retired = count;
+    e.exit(address);
+  }
+  overflow = e.overflow;
+  if (overflow || count == 0) {
+    jit->used = begin;
+    if (!overflow) {
+      jit->interpreted[(start - h.text_start) >> 1] = 1;
+    }
+    return nullptr;
+  }
+  JitEntry entry = reinterpret_cast<JitEntry>(jit->code + begin);
+  jit->blocks[(start - h.text_start) >> 1] = entry;
+  return entry;
+}
+
+// Traduz o bloco que comeca em start. Um bloco que nao coube no que sobrou
+// do buffer e gerado de novo depois de descartar todos os blocos.
+//
+JitEntry jit_translate(Hart &h, uint32_t start) {
+  if (h.jit->used + JIT_BLOCK_MAX_BYTES > JIT_CODE_SIZE) {
+    jit_flush(h.jit);
+  }
+  bool overflow;
+  JitEntry entry = jit_emit_block(h, start, overflow);
+  if (overflow) {
+    jit_flush(h.jit);
+    entry = jit_emit_block(h, start, overflow);
+  }
+  return entry;
+}
+
+/********************************** ENGINE ***********************************/
+
+// Prepara o hart para o JIT, como o inicio de um run(). Devolve false se nao
+// houver memoria executavel.
+//
+bool Hart::start_jit() {
+  if (jit == nullptr) {
+    void *buffer = mmap(nullptr, JIT_CODE_SIZE,
+                        PROT_READ | PROT_WRITE | PROT_EXEC,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED) {
+      return false;
+    }
+    jit = new JitState;
+    jit->code = static_cast<uint8_t *>(buffer);
+  }
+  init();
+  clear_decoded();
+  jit->blocks.assign(decoded_cache.size(), nullptr);
+  jit->translated.assign(decoded_cache.size(), 0);
+  jit->interpreted.assign(decoded_cache.size(), 0);
+  jit_flush(jit);
+  return true;
+}
+
+// Motor JIT. Instrucoes que nao entram em blocos (ECALL, PC impar) sao
+// executadas pelos handlers do motor threaded.
+//
+void Hart::run_jit() {
+  if (!start_jit()) {
+    printf("JIT indisponivel, usando o motor threaded\n");
+    run_threaded();
+    return;
+  }
+  resume_jit();
+  report_finish();
+}
+
+// Laco do JIT, que continua de onde o hart parou. Um bloco sempre roda
+// inteiro, entao pode passar do instret_limit.
+//
+void Hart::resume_jit() {
+  while (running()) {
+    if ((pc & 1) != 0) {
+      step();
+      continue;
+    }
+    uint32_t index = (pc - text_start) >> 1;
+    JitEntry block = jit->blocks[index];
+    if (block == nullptr && !jit->interpreted[index]) {
+      block = jit_translate(*this, pc);
+    }
+    if (block != nullptr) {
+      pc = block(breg, this);
+    } else {
+      const DecodedInstr &d = decoded(pc);
+      d.handler(*this, d);
+      breg[ZERO] = 0;
+      instret++;
+    }
+    if (jit->flush_pending) {
+      jit_flush(jit);
+    }
+  }
+}
+
+#else
+
+void jit_invalidate(JitState *, uint32_t) {}
+
+void jit_release(JitState *) {}
+
+bool Hart::start_jit() { return false; }
+
+void Hart::run_jit() {
+  printf("JIT indisponivel nesta arquitetura, usando o motor threaded\n");
+  run_threaded();
+}
+
+void Hart::resume_jit() { resume_threaded(); }
+
+#endif
@@ -0,0 +1,263 @@
+/*
+ *  lockstep.cpp
+ *
+ * Comparacao de um motor com uma referencia, instrucao a instrucao: o motor
+ * switch rodando o mesmo programa num segundo hart (main.exe -L) ou um trace
+ * gravado antes com -t (main.exe -D). Serve para validar os motores rapidos
+ * (threaded, JIT) contra o execute() em qualquer programa.
+ *
+ * O motor testado roda em fatias: o instret_limit e posto uma instrucao a
+ * frente e o laco do motor (resume*) e chamado de novo. No switch e no
+ * threaded cada fatia e uma instrucao; no JIT e um bloco inteiro, que nao
+ * para no meio. Depois de cada fatia a referencia anda o mesmo numero de
+ * instrucoes e os dois sao comparados: PC, os 32 registradores e as escritas
+ * na memoria feitas na fatia (endereco, tamanho e valor, na ordem). Na
+ * primeira diferenca a execucao para e sao impressos o que diferiu, as
+ * instrucoes da fatia e os registradores do motor testado.
+ *
+ * Os ecalls nao sao comparados, sao repetidos: contra o segundo hart, a
+ * referencia nao executa o ecall, copia os registradores, o estado de saida
+ * e as escritas na memoria do motor testado (so ele le a entrada e escreve
+ * na saida e nos arquivos); contra o trace, o motor testado recebe os
+ * registradores gravados, entao o tempo (ecall 30) e a entrada sao os da
+ * execucao gravada. Um ecall sempre fecha a fatia, ja que o JIT nao o poe em
+ * blocos.
+ */
+
+// Instrucao executada pela referencia. Contra o segundo hart a instrucao so
+// e lida da memoria no relatorio (size = 0 ate la).
+//
+struct LockstepInstr {
+  uint32_t pc, word, size;
+};
+
+// Uma comparacao em andamento
+//
+struct Lockstep {
+  Hart *reference;    // segundo hart, nulo se a referencia e o trace
+  TraceReader trace;  // referencia gravada
+  vector<StoreRecord> stores;    // escritas do testado na fatia
+  vector<StoreRecord> expected;  // e as da referencia
+  vector<LockstepInstr> slice;   // instrucoes da referencia na fatia
+  bool ecall;  // a fatia terminou num ecall
+  bool ended;  // o trace acabou antes do motor testado
+};
+
+// Anda o hart de referencia ate ele chegar ao instret do testado. O ecall
+// copia o que o testado fez.
+//
+void lockstep_step_hart(Lockstep &l, Hart &test) {
+  Hart &ref = *l.reference;
+  while (ref.instret < test.instret && ref.running()) {
+    l.slice.push_back(LockstepInstr{ref.pc, 0, 0});
+    ref.instret++;
+    ref.fetch_decoded();
+    if (ref.mem.fault) {
+      return;
+    }
+    if (ref.instruction != I_ecall) {
+      ref.retire();
+      continue;
+    }
+    l.ecall = true;
+    memcpy(ref.breg, test.breg, sizeof(ref.breg));
+    for (const StoreRecord &s : l.stores) {
+      ref.write_bytes(s.address, &s.value, 1);
+    }
+    ref.pc = test.pc;
+    ref.brk = test.brk;
+    ref.stop_prg = test.stop_prg;
+    ref.exit_code = test.exit_code;
+    ref.exit_reason = test.exit_reason;
+    ref.mem.fault = test.mem.fault;
+    ref.mem.fault_address = test.mem.fault_address;
+  }
+}
+
+// Le do trace as instrucoes da fatia. O ecall passa os registradores
+// gravados para o testado.
+//
+void lockstep_step_trace(Lockstep &l, Hart &test) {
+  TraceEntry e;
+  while (l.trace.count < test.instret) {
+    if (trace_next(l.trace, e) <= 0) {
+      l.ended = true;
+      return;
+    }
+    l.slice.push_back(
+        LockstepInstr{e.pc, e.word, (e.flags & TRACE_COMPRESSED) ? 2u : 4u});
+    if (e.flags & TRACE_STORE) {
+      uint32_t size = 1u << ((e.word >> 12) & 3);
+      uint32_t value = size == 4 ? e.value : e.value & ((1u << size * 8) - 1);
+      l.expected.push_back(StoreRecord{e.address, size, value});
+    }
+    if (decode_lookup(e.word) == I_ecall) {
+      l.ecall = true;
+      memcpy(test.breg, l.trace.regs, sizeof(test.breg));
+    }
+  }
+}
+
+// Imprime uma escrita na memoria, ou "nenhuma"
+//
+void print_store(const char *label, const vector<StoreRecord> &stores,
+                 size_t i) {
+  if (i < stores.size()) {
+    printf("  %s [%08x] <- %0*x (%u bytes)\n", label, stores[i].address,
+           stores[i].size * 2, stores[i].value, stores[i].size);
+  } else {
+    printf("  %s nenhuma escrita\n", label);
+  }
+}
+
+// Compara o testado com a referencia depois da fatia que comecou em pc.
+// Devolve false se houver alguma diferenca; com print, imprime cada uma.
+//
+bool lockstep_compare(Lockstep &l, Hart &test, uint32_t pc, bool print) {
+  const int32_t *regs = l.reference ? l.reference->breg : l.trace.regs;
+  bool ok = true;
+  if (l.ended && !test.mem.fault) {
+    if (print) {
+      printf("  o trace acabou antes do motor testado\n");
+    }
+    ok = false;
+  }
+  // contra o trace so o PC do inicio da fatia e conhecido
+  if (!l.slice.empty() && l.slice[0].pc != pc) {
+    if (print) {
+      printf("  PC: esperado %08x, obtido %08x\n", l.slice[0].pc, pc);
+    }
+    ok = false;
+  }
+  if (l.reference != nullptr && l.reference->pc != test.pc) {
+    if (print) {
+      printf("  PC seguinte: esperado %08x, obtido %08x\n",
+             l.reference->pc, test.pc);
+    }
+    ok = false;
+  }
+  for (int i = 1; i < 32; i++) {
+    if (regs[i] != test.breg[i]) {
+      if (print) {
+        printf("  %s: esperado %08x, obtido %08x\n", reg_str[i],
+               regs[i], test.breg[i]);
+      }
+      ok = false;
+    }
+  }
+  // as escritas de um ecall contra o trace nao estao no trace
+  bool compare_stores = l.reference != nullptr || !l.ecall;
+  for (size_t i = 0;
+       compare_stores && i < max(l.expected.size(), l.stores.size()); i++) {
+    if (i >= l.expected.size() || i >= l.stores.size() ||
+        memcmp(&l.expected[i], &l.stores[i], sizeof(StoreRecord)) != 0) {
+      if (print) {
+        print_store("esperado", l.expected, i);
+        print_store("obtido  ", l.stores, i);
+      }
+      ok = false;
+      break;
+    }
+  }
+  return ok;
+}
+
+// Imprime o contexto da divergencia: as instrucoes da fatia e os
+// registradores do motor testado
+//
+void lockstep_report(Lockstep &l, Hart &test) {
+  printf("Instrucoes da referencia nesta fatia:\n");
+  for (LockstepInstr &instr : l.slice) {
+    if (instr.size == 0) {
+      instr.word = l.reference->read_instr(instr.pc, instr.size);
+    }
+    printf("  ");
+    print_instr(instr.pc, instr.word, instr.size == 2);
+    printf("\n");
+  }
+  printf("Registradores do motor testado:\n");
+  test.dump_breg();
+}
+
+// Roda o programa ja carregado em test com o motor engine, comparando com
+// a referencia: o hart reference (com o mesmo programa carregado) ou, se ele
+// for nulo, o trace trace_path. Devolve -1 na primeira divergencia.
+//
+int run_lockstep(Hart &test, ENGINES engine, Hart *reference,
+                 const char *trace_path) {
+  Lockstep l;
+  l.reference = reference;
+  l.trace.in = nullptr;
+  l.ended = false;
+  if (reference == nullptr && !trace_open(l.trace, trace_path)) {
+    return -1;
+  }
+  string reference_console;
+  if (reference != nullptr) {
+    reference->stores = &l.expected;
+    reference->console.capture = &reference_console;
+    reference->console.in = nullptr;
+    reference->init();
+    reference->clear_decoded();
+  }
+  engine = test.start_engine(engine);
+  test.stores = &l.stores;
+  uint64_t limit = test.instret_limit;
+
+  bool ok = true;
+  if (reference == nullptr &&
+      (l.trace.header.pc != test.pc ||
+       memcmp(l.trace.header.breg, test.breg, sizeof(test.breg)) != 0)) {
+    printf("Divergencia no estado inicial: o trace comeca em %08x\n",
+           l.trace.header.pc);
+    ok = false;
+  }
+  while (ok && test.running()) {
+    uint32_t pc = test.pc;
+    uint64_t before = test.instret;
+    l.stores.clear();
+    l.expected.clear();
+    l.slice.clear();
+    l.ecall = false;
+    test.instret_limit = min(limit, test.instret + 1);
+    test.resume_engine(engine);
+    test.instret_limit = limit;
+    if (reference != nullptr) {
+      lockstep_step_hart(l, test);
+    } else {
+      lockstep_step_trace(l, test);
+    }
+    if (!lockstep_compare(l, test, pc, false)) {
+      test.console.flush();
+      printf("Divergencia na instrucao %llu (PC %08x):\n",
+             (unsigned long long)before + 1, pc);
+      lockstep_compare(l, test, pc, true);
+      lockstep_report(l, test);
+      ok = false;
+    }
+  }
+  test.stores = nullptr;
+  if (ok) {
+    test.report_finish();
+    TraceEntry e;
+    bool stopped = !test.mem.fault && test.exit_reason != EXIT_LIMIT;
+    if (reference != nullptr && reference->running() && stopped) {
+      printf("A referencia continua depois do fim, no PC %08x\n",
+             reference->pc);
+      ok = false;
+    } else if (reference == nullptr && stopped &&
+               trace_next(l.trace, e) > 0) {
+      printf("O trace continua depois do fim, no PC %08x\n", e.pc);
+      ok = false;
+    }
+  }
+  if (reference != nullptr) {
+    reference->stores = nullptr;
+  }
+  trace_close(l.trace);
+  if (ok) {
+    printf("Sem divergencias em %llu instrucoes\n",
+           (unsigned long long)test.instret);
+  }
+  return ok ? 0 : -1;
+}
@@ -7,18 +7,241 @@
  *
  */
 
+#include <array>
+#include <cstdlib>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 using namespace std;
 
 #include "riscv.cpp"
+#include "rvc.cpp"
+#include "disasm.cpp"
+#include "snapshot.cpp"
+#include "syscalls.cpp"
+#include "elf.cpp"
+#include "threaded.cpp"
+#include "jit.cpp"
+#include "profile.cpp"
+#include "trace.cpp"
+#include "cache.cpp"
+#include "pipeline.cpp"
+#include "lockstep.cpp"
+#include "debug.cpp"
+#include "gdbstub.cpp"
+#include "smp.cpp"
+#include "batch.cpp"
+#include "bench.cpp"
 
-int main() {
-  load_mem("code.bin", 0);
-  load_mem("data.bin", 0x2000);
-  run();
+// Uso: main.exe [-e switch|threaded|jit] [-l limite] [-p perfil] [-t trace]
+//               [-S snapshot] [-b manifesto [-j n]] [-B kernels [-w n] [-n n]]
+//               [-m caches] [-P preditor] [-T trace] [-L | -D trace]
+//               [-H harts] [-d | -g porta] [programa.elf | estado.snap]
+//   Sem programa roda os dumps code.bin/data.bin do diretorio atual. Um
+//   snapshot (ver snapshot.cpp) continua de onde foi gravado.
+//   -e  motor de execucao. O switch do execute() e o motor de referencia.
+//   -l  para depois de executar este numero de instrucoes
+//   -p  grava o perfil de execucao neste arquivo e a pilha de chamadas em
+//       perfil.folded (ver profile.cpp). Sempre usa o motor switch.
+//   -t  grava o trace binario da execucao neste arquivo (ver trace.cpp).
+//       Sempre usa o motor switch.
+//   -m  simula as caches com esta configuracao ("padrao" ou ver cache.cpp)
+//       e imprime faltas e ciclos estimados. Sempre usa o motor switch.
+//   -P  estima os ciclos num pipeline de 5 estagios com o preditor de
+//       desvios static, bimodal ou gshare (ver pipeline.cpp). Com -m soma as
+//       faltas nas caches. Sempre usa o motor switch.
+//   -T  imprime em texto o trace gravado com -t
+//   -L  compara o motor do -e, instrucao a instrucao, com o motor switch
+//       rodando o mesmo programa (ver lockstep.cpp)
+//   -D  compara o motor do -e com o trace gravado antes com -t
+//   -d  depurador interativo: passo a passo, breakpoints, watchpoints e
+//       inspecao do estado (ver debug.cpp). Sempre usa o motor threaded e
+//       nao funciona com -p, -t, -m, -P, -L, -D nem -H.
+//   -g  espera o GDB nesta porta TCP de localhost ou neste socket Unix e
+//       roda o programa sob ele (ver gdbstub.cpp). Como o -d.
+//   -H  roda o programa com este numero de harts dividindo a memoria, cada
+//       um numa thread (ver smp.cpp). Nao funciona com -p, -t, -m, -P, -L,
+//       -D nem -S.
+//   -S  grava o estado neste arquivo quando o programa chama o ecall de
+//       snapshot ou para no limite do -l
+//   -b  modo batch: roda todos os programas do manifesto (ver batch.cpp)
+//   -j  numero de threads do modo batch (padrao: uma por nucleo)
+//   -B  benchmark: roda os kernels da lista e imprime MIPS (ver bench.cpp)
+//   -w  execucoes de aquecimento de cada kernel (padrao: 1)
+//   -n  execucoes medidas de cada kernel (padrao: 5)
+//
+// Carrega o programa no hart: snapshot, ELF ou, sem programa, os dumps do
+// diretorio atual. Devolve false se nao conseguir.
+//
+bool load_program(Hart &h, const char *program) {
+  if (program != nullptr && is_snapshot(program)) {
+    shared_ptr<const Snapshot> s = load_snapshot(program);
+    if (s == nullptr) {
+      printf("Snapshot invalido: %s\n", program);
+      return false;
+    }
+    h.restore(s, 0);
+  } else if (program != nullptr) {
+    return h.load_elf(program);
+  } else {
+    h.load_mem("code.bin", 0);
+    h.load_mem("data.bin", 0x2000);
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  ENGINES engine = E_SWITCH;
+  uint64_t limit = UINT64_MAX;
+  const char *manifest = nullptr;
+  unsigned threads = 0;
+  const char *program = nullptr;
+  const char *profile = nullptr;
+  const char *snapshot = nullptr;
+  const char *trace = nullptr;
+  const char *trace_text = nullptr;
+  const char *reference_trace = nullptr;
+  const char *caches = nullptr;
+  const char *predictor = nullptr;
+  bool lockstep = false;
+  bool debug = false;
+  const char *gdb = nullptr;
+  unsigned harts = 1;
+  const char *kernels = nullptr;
+  int warmup = 1;
+  int iterations = 5;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+      i++;
+      if (strcmp(argv[i], "switch") == 0) {
+        engine = E_SWITCH;
+      } else if (strcmp(argv[i], "threaded") == 0) {
+        engine = E_THREADED;
+      } else if (strcmp(argv[i], "jit") == 0) {
+        engine = E_JIT;
+      } else {
+        printf("Motor desconhecido: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+      limit = strtoull(argv[++i], nullptr, 0);
+    } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      profile = argv[++i];
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      trace = argv[++i];
+    } else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+      trace_text = argv[++i];
+    } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+      caches = argv[++i];
+    } else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc) {
+      predictor = argv[++i];
+    } else if (strcmp(argv[i], "-L") == 0) {
+      lockstep = true;
+    } else if (strcmp(argv[i], "-d") == 0) {
+      debug = true;
+    } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+      gdb = argv[++i];
+    } else if (strcmp(argv[i], "-D") == 0 && i + 1 < argc) {
+      reference_trace = argv[++i];
+    } else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+      harts = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+      snapshot = argv[++i];
+    } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      manifest = argv[++i];
+    } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-B") == 0 && i + 1 < argc) {
+      kernels = argv[++i];
+    } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+      warmup = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else if (argv[i][0] != '-') {
+      program = argv[i];
+    }
+  }
+
+  if (trace_text != nullptr) {
+    return read_trace(trace_text) < 0 ? 1 : 0;
+  }
+  if (kernels != nullptr) {
+    return run_bench(kernels, engine, warmup, iterations) < 0 ? 1 : 0;
+  }
+  if (manifest != nullptr) {
+    return run_batch(manifest, threads, engine, limit) < 0 ? 1 : 0;
+  }
+  if (harts > 1 && (profile != nullptr || trace != nullptr ||
+                    caches != nullptr || predictor != nullptr || lockstep ||
+                    reference_trace != nullptr || snapshot != nullptr)) {
+    printf("-H nao funciona com -p, -t, -m, -P, -L, -D nem -S\n");
+    return 1;
+  }
+  if ((debug || gdb != nullptr) &&
+      (profile != nullptr || trace != nullptr || caches != nullptr ||
+       predictor != nullptr || lockstep || reference_trace != nullptr ||
+       harts > 1 || (debug && gdb != nullptr))) {
+    printf("-d e -g nao funcionam juntos nem com -p, -t, -m, -P, -L, -D "
+           "e -H\n");
+    return 1;
+  }
+
+  hart.instret_limit = limit;
+  if (profile != nullptr) {
+    hart.profile = profile_new(profile);
+  }
+  if (trace != nullptr) {
+    hart.trace = trace_new(trace);
+  }
+  if (caches != nullptr) {
+    hart.cache = cache_new(caches);
+    if (hart.cache == nullptr) {
+      return 1;
+    }
+  }
+  if (predictor != nullptr) {
+    hart.pipeline = pipeline_new(predictor);
+    if (hart.pipeline == nullptr) {
+      return 1;
+    }
+  }
+  if (snapshot != nullptr) {
+    hart.snapshot_path = snapshot;
+  }
+  if (!load_program(hart, program)) {
+    return 1;
+  }
+  if (debug) {
+    run_debugger(hart);
+    return hart.exit_code;
+  }
+  if (gdb != nullptr) {
+    return run_gdb(hart, gdb) < 0 ? 1 : hart.exit_code;
+  }
+  if (lockstep || reference_trace != nullptr) {
+    Hart *reference = nullptr;
+    if (lockstep) {
+      reference = new Hart();
+      load_program(*reference, program);
+    }
+    int status = run_lockstep(hart, engine, reference, reference_trace);
+    delete reference;
+    return status < 0 ? 1 : hart.exit_code;
+  }
+  if (harts > 1) {
+    return run_smp(hart, harts, engine) < 0 ? 1 : hart.exit_code;
+  }
+  run_engine(hart, engine);
+  if (snapshot != nullptr && hart.exit_reason == EXIT_LIMIT &&
+      !save_snapshot(hart, snapshot, hart.pc)) {
+    printf("Nao foi possivel gravar %s\n", snapshot);
+    return 1;
+  }
 
-  return 0;
+  return hart.exit_code;
 }
@@ -0,0 +1,291 @@
+/*
+ *  pipeline.cpp
+ *
+ * Modelo de tempo de um pipeline classico de 5 estagios (IF, ID, EX, MEM,
+ * WB), em ordem e com uma instrucao por ciclo. O modelo nao executa nada: o
+ * nucleo funcional (fetch_decoded/retire) continua sendo quem da o resultado
+ * e, depois de cada instrucao completada, o modelo so conta as bolhas que
+ * ela teria causado, olhando a instrucao, os registradores que ela le e
+ * escreve e o PC seguinte. Ele tem o seu proprio laco (Hart::run_pipelined),
+ * entao o run() normal nao paga nada quando ele esta desligado.
+ *
+ * Bolhas contadas:
+ *   - load-use: com forwarding de EX e de MEM para EX, so uma instrucao que
+ *     usa o resultado do load imediatamente anterior espera 1 ciclo;
+ *   - desvio condicional, resolvido no EX: previsao errada custa 2 ciclos e
+ *     tomado previsto certo custa 1 (o destino so sai do ID);
+ *   - jal custa 1 ciclo (destino no ID) e jalr 2 (destino no EX);
+ *   - com o modelo de cache ligado (-m), cada ciclo alem do primeiro de uma
+ *     busca (IF) ou de um acesso a dados (MEM).
+ * O total e instrucoes + 4 (encher o pipeline) + bolhas. As bolhas sao
+ * somadas sem sobreposicao, entao o resultado e uma aproximacao.
+ *
+ * Preditores dos desvios condicionais (main.exe -P):
+ *   static   tomado para tras, nao tomado para frente (BTFN);
+ *   bimodal  contadores de 2 bits indexados pelo PC;
+ *   gshare   contadores de 2 bits indexados pelo PC xor a historia global.
+ */
+
+enum { PIPE_PREDICTOR_BITS = 12 };  // 4096 contadores
+enum { PIPE_FILL = 4 };             // ciclos para encher o pipeline
+
+enum PREDICTORS { P_STATIC, P_BIMODAL, P_GSHARE };
+
+const char *const predictor_names[] = {"static", "bimodal", "gshare"};
+
+// O que cada instrucao usa, para as dependencias e os desvios
+enum {
+  PIPE_RS1 = 1,     // le rs1
+  PIPE_RS2 = 2,     // le rs2
+  PIPE_LOAD = 4,    // escreve rd no MEM
+  PIPE_BRANCH = 8,  // desvio condicional
+  PIPE_JAL = 16,
+  PIPE_JALR = 32
+};
+
+// Motivos das bolhas
+enum PIPE_STALLS {
+  S_LOAD_USE,
+  S_MISPREDICT,
+  S_TAKEN,
+  S_JAL,
+  S_JALR,
+  S_ICACHE,
+  S_DCACHE,
+  S_KINDS
+};
+
+const char *const stall_names[S_KINDS] = {
+    "load-use",     "desvio previsto errado", "desvio tomado", "jal",
+    "jalr",         "cache de instrucoes",    "cache de dados"};
+
+struct Pipeline {
+  PREDICTORS predictor;
+  vector<uint8_t> counters;  // contadores de 2 bits do bimodal e do gshare
+  uint32_t history;          // desvios recentes do gshare, 1 = tomado
+  uint32_t load_rd;          // rd do load anterior, 0 se nao foi load
+  uint8_t operands[I_nop + 1];  // PIPE_* de cada instrucao
+  uint64_t stalls[S_KINDS];
+  uint64_t branches, correct;  // desvios condicionais e previsoes certas
+};
+
+// PIPE_* de uma instrucao
+//
+uint8_t pipe_operands(INSTRUCTIONS instruction) {
+  switch (instruction) {
+    case I_beq:
+    case I_bne:
+    case I_blt:
+    case I_bge:
+    case I_bltu:
+    case I_bgeu:
+      return PIPE_RS1 | PIPE_RS2 | PIPE_BRANCH;
+    case I_sb:
+    case I_sh:
+    case I_sw:
+      return PIPE_RS1 | PIPE_RS2;
+    case I_lb:
+    case I_lbu:
+    case I_lh:
+    case I_lhu:
+    case I_lw:
+    case I_lr_w:
+      return PIPE_RS1 | PIPE_LOAD;
+    case I_sc_w:
+    case I_amoswap_w:
+    case I_amoadd_w:
+    case I_amoxor_w:
+    case I_amoand_w:
+    case I_amoor_w:
+    case I_amomin_w:
+    case I_amomax_w:
+    case I_amominu_w:
+    case I_amomaxu_w:
+      return PIPE_RS1 | PIPE_RS2 | PIPE_LOAD;
+    case I_jal:
+      return PIPE_JAL;
+    case I_jalr:
+      return PIPE_RS1 | PIPE_JALR;
+    case I_addi:
+    case I_andi:
+    case I_ori:
+    case I_xori:
+    case I_slti:
+    case I_sltiu:
+    case I_slli:
+    case I_srli:
+    case I_srai:
+      return PIPE_RS1;
+    case I_lui:
+    case I_auipc:
+    case I_ecall:
+    case I_fence:
+    case I_nop:
+      return 0;
+    default:  // tipo R
+      return PIPE_RS1 | PIPE_RS2;
+  }
+}
+
+// Cria o modelo com o preditor de nome name. Devolve nulo se o nome nao
+// existir.
+//
+Pipeline *pipeline_new(const char *name) {
+  int predictor = 0;
+  while (predictor <= P_GSHARE &&
+         strcmp(name, predictor_names[predictor]) != 0) {
+    predictor++;
+  }
+  if (predictor > P_GSHARE) {
+    printf("Preditor desconhecido: %s\n", name);
+    return nullptr;
+  }
+  Pipeline *p = new Pipeline;
+  p->predictor = (PREDICTORS)predictor;
+  for (int i = 0; i <= I_nop; i++) {
+    p->operands[i] = pipe_operands((INSTRUCTIONS)i);
+  }
+  return p;
+}
+
+void pipeline_release(Pipeline *p) { delete p; }
+
+void pipeline_reset(Pipeline &p) {
+  p.counters.assign(1 << PIPE_PREDICTOR_BITS, 1);  // fracamente nao tomado
+  p.history = 0;
+  p.load_rd = 0;
+  fill(p.stalls, p.stalls + S_KINDS, 0);
+  p.branches = p.correct = 0;
+}
+
+/********************************* PREDICAO **********************************/
+
+// Contador do desvio em pc
+//
+uint8_t &pipe_counter(Pipeline &p, uint32_t pc) {
+  uint32_t index = pc >> 1;
+  if (p.predictor == P_GSHARE) {
+    index ^= p.history;
+  }
+  return p.counters[index & ((1 << PIPE_PREDICTOR_BITS) - 1)];
+}
+
+// Preve o desvio condicional em pc, que salta para target, e atualiza o
+// preditor com o resultado. Devolve true se a previsao acertou.
+//
+bool pipe_predict(Pipeline &p, uint32_t pc, uint32_t target, bool taken) {
+  bool predicted;
+  if (p.predictor == P_STATIC) {
+    predicted = target < pc;
+  } else {
+    uint8_t &counter = pipe_counter(p, pc);
+    predicted = counter >= 2;
+    if (taken && counter < 3) {
+      counter++;
+    } else if (!taken && counter > 0) {
+      counter--;
+    }
+    p.history = (p.history << 1 | taken) & ((1 << PIPE_PREDICTOR_BITS) - 1);
+  }
+  return predicted == taken;
+}
+
+/********************************** BOLHAS ***********************************/
+
+// Conta as bolhas da instrucao que acabou de completar em at. next e o PC
+// seguinte e target o destino de um desvio condicional.
+//
+void pipeline_record(Pipeline &p, INSTRUCTIONS instruction, uint32_t rd,
+                     uint32_t rs1, uint32_t rs2, uint32_t at, uint32_t size,
+                     uint32_t next, uint32_t target) {
+  uint8_t operands = p.operands[instruction];
+  if (p.load_rd != 0 &&
+      (((operands & PIPE_RS1) && rs1 == p.load_rd) ||
+       ((operands & PIPE_RS2) && rs2 == p.load_rd))) {
+    p.stalls[S_LOAD_USE]++;
+  }
+  p.load_rd = (operands & PIPE_LOAD) ? rd : 0;
+
+  if (operands & PIPE_BRANCH) {
+    bool taken = next != at + size;
+    p.branches++;
+    if (pipe_predict(p, at, target, taken)) {
+      p.correct++;
+      p.stalls[S_TAKEN] += taken;
+    } else {
+      p.stalls[S_MISPREDICT] += 2;
+    }
+  } else if (operands & PIPE_JAL) {
+    p.stalls[S_JAL]++;
+  } else if (operands & PIPE_JALR) {
+    p.stalls[S_JALR] += 2;
+  }
+}
+
+/********************************* RELATORIO *********************************/
+
+void pipeline_report(Pipeline &p, uint64_t instret) {
+  uint64_t stalls = 0;
+  for (uint64_t count : p.stalls) {
+    stalls += count;
+  }
+  uint64_t cycles = instret > 0 ? instret + PIPE_FILL + stalls : 0;
+  printf("pipeline de 5 estagios, preditor %s\n",
+         predictor_names[p.predictor]);
+  printf("ciclos: %llu (CPI %.3f)\n", (unsigned long long)cycles,
+         instret > 0 ? (double)cycles / instret : 0.0);
+  printf("bolhas: %llu\n", (unsigned long long)stalls);
+  for (int i = 0; i < S_KINDS; i++) {
+    if (p.stalls[i] > 0) {
+      printf("  %-24s %12llu %6.2f%%\n", stall_names[i],
+             (unsigned long long)p.stalls[i], 100.0 * p.stalls[i] / cycles);
+    }
+  }
+  printf("desvios condicionais: %llu, acertos do preditor: %llu (%.2f%%)\n",
+         (unsigned long long)p.branches, (unsigned long long)p.correct,
+         p.branches > 0 ? 100.0 * p.correct / p.branches : 0.0);
+}
+
+/********************************** ENGINE ***********************************/
+
+// Motor de referencia com o modelo do pipeline e, se estiver ligado, o de
+// cache
+//
+void Hart::run_pipelined() {
+  init();
+  clear_decoded();
+  pipeline_reset(*pipeline);
+  if (cache != nullptr) {
+    cache_reset(*cache);
+  }
+  while (running()) {
+    uint32_t at = pc;
+    instret++;
+    fetch_decoded();
+    if (mem.fault) {
+      break;
+    }
+    INSTRUCTIONS executed = instruction;
+    uint32_t size = ilen;
+    uint32_t used_rd = rd, used_rs1 = rs1, used_rs2 = rs2;
+    uint32_t address = breg[rs1] + imm32_t;
+    uint32_t target = at + imm32_t;
+    retire();
+    if (mem.fault) {
+      break;
+    }
+    pipeline_record(*pipeline, executed, used_rd, used_rs1, used_rs2, at, size,
+                    pc, target);
+    if (cache != nullptr) {
+      uint32_t fetch = cache_touch(*cache, C_L1I, at, size, false);
+      uint32_t data = cache_data(*cache, executed, address);
+      pipeline->stalls[S_ICACHE] += fetch > 1 ? fetch - 1 : 0;
+      pipeline->stalls[S_DCACHE] += data > 1 ? data - 1 : 0;
+    }
+  }
+  report_finish();
+  pipeline_report(*pipeline, instret);
+  if (cache != nullptr) {
+    cache_report(*cache, instret);
+  }
+}
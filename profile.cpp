@@ -0,0 +1,232 @@
+/*
+ *  profile.cpp
+ *
+ * Perfil de execucao no nivel de instrucao. Conta quantas vezes cada PC e
+ * cada instrucao (INSTRUCTIONS) foram executados e, para cada desvio
+ * condicional, quantas vezes ele foi tomado.
+ *
+ * Tambem mantem uma pilha de chamadas sombra: jal/jalr que escrevem ra (ou
+ * t0) empilham o destino e jalr x0 que le ra (ou t0) desempilha. Cada pilha
+ * distinta vira um no de uma arvore, e cada instrucao soma um no no atual.
+ * Isso gera o arquivo .folded, no formato do flamegraph.pl
+ * ("main;f;g contagem"), com os nomes das funcoes do ELF quando existem.
+ *
+ * O perfil tem o seu proprio laco (Hart::run_profiled), entao o run() normal
+ * nao paga nada quando ele esta desligado.
+ */
+
+#include <algorithm>
+
+enum { PROFILE_TOP = 30 };  // linhas de cada tabela do relatorio
+
+struct Profile {
+  string path;                // relatorio; o .folded fica em path + ".folded"
+  // Indexados por meia palavra do texto, como a cache de instrucoes
+  vector<uint64_t> pc_count;  // execucoes de cada PC
+  vector<uint64_t> taken;     // vezes que o desvio em cada PC foi tomado
+  uint64_t instr_count[I_nop + 1];
+
+  // Arvore de pilhas de chamada. O no 0 e a funcao do PC inicial.
+  vector<int> parent;
+  vector<uint32_t> function;  // endereco da funcao de cada no
+  vector<uint64_t> self;      // instrucoes executadas com esta pilha
+  map<pair<int, uint32_t>, int> children;
+  int current;
+};
+
+Profile *profile_new(const char *path) {
+  Profile *p = new Profile;
+  p->path = path;
+  return p;
+}
+
+void profile_release(Profile *p) { delete p; }
+
+// Zera os contadores para o texto atual do hart
+//
+void profile_reset(Profile &p, Hart &h) {
+  p.pc_count.assign(h.text_size >> 1, 0);
+  p.taken.assign(h.text_size >> 1, 0);
+  fill(p.instr_count, p.instr_count + I_nop + 1, 0);
+  p.parent.assign(1, -1);
+  p.function.assign(1, h.pc);
+  p.self.assign(1, 0);
+  p.children.clear();
+  p.current = 0;
+}
+
+bool is_branch(INSTRUCTIONS instruction) {
+  switch (instruction) {
+    case I_beq:
+    case I_bne:
+    case I_blt:
+    case I_bge:
+    case I_bltu:
+    case I_bgeu:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool is_link(uint32_t r) { return r == RA || r == T0; }
+
+// Registra a instrucao que estava em at e acabou de ser executada
+//
+void profile_record(Profile &p, Hart &h, uint32_t at) {
+  uint32_t index = (at - h.text_start) >> 1;
+  p.pc_count[index]++;
+  p.instr_count[h.instruction]++;
+  p.self[p.current]++;
+  if (is_branch(h.instruction)) {
+    if (h.pc != at + h.ilen) {
+      p.taken[index]++;
+    }
+  } else if ((h.instruction == I_jal || h.instruction == I_jalr) &&
+             is_link(h.rd)) {
+    auto key = make_pair(p.current, h.pc);
+    auto child = p.children.find(key);
+    if (child == p.children.end()) {
+      child = p.children.emplace(key, p.parent.size()).first;
+      p.parent.push_back(p.current);
+      p.function.push_back(h.pc);
+      p.self.push_back(0);
+    }
+    p.current = child->second;
+  } else if (h.instruction == I_jalr && h.rd == ZERO && is_link(h.rs1) &&
+             p.current != 0) {
+    p.current = p.parent[p.current];
+  }
+}
+
+// Nome de uma funcao: o simbolo do ELF ou o endereco
+//
+string profile_name(Hart &h, uint32_t address) {
+  auto symbol = h.functions.find(address);
+  if (symbol != h.functions.end()) {
+    return symbol->second;
+  }
+  char text[16];
+  snprintf(text, sizeof(text), "0x%08x", address);
+  return text;
+}
+
+// Funcao que contem o endereco, pelo simbolo mais proximo abaixo dele
+//
+string profile_owner(Hart &h, uint32_t address) {
+  auto symbol = h.functions.upper_bound(address);
+  if (symbol == h.functions.begin()) {
+    return "";
+  }
+  return (--symbol)->second;
+}
+
+// Grava o relatorio ordenado e o arquivo .folded
+//
+void profile_write(Profile &p, Hart &h) {
+  FILE *out = fopen(p.path.c_str(), "w");
+  if (out == nullptr) {
+    printf("Nao foi possivel escrever %s\n", p.path.c_str());
+    return;
+  }
+  uint64_t total = 0;
+  for (uint64_t count : p.instr_count) {
+    total += count;
+  }
+  double scale = total > 0 ? 100.0 / total : 0.0;
+  fprintf(out, "Perfil: %llu instrucoes\n", (unsigned long long)total);
+
+  vector<uint32_t> pcs;
+  for (uint32_t i = 0; i < p.pc_count.size(); i++) {
+    if (p.pc_count[i] > 0) {
+      pcs.push_back(i);
+    }
+  }
+  sort(pcs.begin(), pcs.end(), [&](uint32_t a, uint32_t b) {
+    return p.pc_count[a] > p.pc_count[b];
+  });
+  fprintf(out, "\n--- PCs mais executados ---\n");
+  fprintf(out, "      PC       execucoes       %%  instrucao  funcao\n");
+  for (size_t i = 0; i < pcs.size() && i < PROFILE_TOP; i++) {
+    uint32_t address = h.text_start + pcs[i] * 2;
+    const DecodedInstr &d = h.decoded(address);
+    fprintf(out, "%08x  %14llu  %6.2f  %-9s  %s\n", address,
+            (unsigned long long)p.pc_count[pcs[i]], p.pc_count[pcs[i]] * scale,
+            d.valid ? instr_info[d.instruction].name : "?",
+            profile_owner(h, address).c_str());
+  }
+
+  vector<int> instrs;
+  for (int i = 0; i <= I_nop; i++) {
+    if (p.instr_count[i] > 0) {
+      instrs.push_back(i);
+    }
+  }
+  sort(instrs.begin(), instrs.end(), [&](int a, int b) {
+    return p.instr_count[a] > p.instr_count[b];
+  });
+  fprintf(out, "\n--- instrucoes ---\n");
+  for (int i : instrs) {
+    fprintf(out, "%-9s  %14llu  %6.2f\n", instr_info[i].name,
+            (unsigned long long)p.instr_count[i], p.instr_count[i] * scale);
+  }
+
+  vector<uint32_t> branches;
+  for (uint32_t i : pcs) {
+    const DecodedInstr &d = h.decoded(h.text_start + i * 2);
+    if (d.valid && is_branch(d.instruction)) {
+      branches.push_back(i);
+    }
+  }
+  fprintf(out, "\n--- desvios ---\n");
+  fprintf(out, "      PC       execucoes         tomados     nao tomados  "
+               "%%tomado\n");
+  for (size_t i = 0; i < branches.size() && i < PROFILE_TOP; i++) {
+    uint32_t b = branches[i];
+    fprintf(out, "%08x  %14llu  %14llu  %14llu  %6.2f\n",
+            h.text_start + b * 2, (unsigned long long)p.pc_count[b],
+            (unsigned long long)p.taken[b],
+            (unsigned long long)(p.pc_count[b] - p.taken[b]),
+            100.0 * p.taken[b] / p.pc_count[b]);
+  }
+  fclose(out);
+
+  string folded_path = p.path + ".folded";
+  FILE *folded = fopen(folded_path.c_str(), "w");
+  if (folded == nullptr) {
+    printf("Nao foi possivel escrever %s\n", folded_path.c_str());
+    return;
+  }
+  for (size_t node = 0; node < p.self.size(); node++) {
+    if (p.self[node] == 0) {
+      continue;
+    }
+    string stack;
+    for (int n = node; n >= 0; n = p.parent[n]) {
+      stack = profile_name(h, p.function[n]) + (stack.empty() ? "" : ";") +
+              stack;
+    }
+    fprintf(folded, "%s %llu\n", stack.c_str(),
+            (unsigned long long)p.self[node]);
+  }
+  fclose(folded);
+}
+
+/********************************** ENGINE ***********************************/
+
+// Motor de referencia com o perfil ligado
+//
+void Hart::run_profiled() {
+  init();
+  clear_decoded();
+  profile_reset(*profile, *this);
+  while (running()) {
+    uint32_t at = pc;
+    step();
+    if (!mem.fault) {
+      profile_record(*profile, *this, at);
+    }
+  }
+  report_finish();
+  profile_write(*profile, *this);
+}
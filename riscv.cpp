@@ -1,298 +1,403 @@
 /*
  *  riscv.cpp
  *
- * Instructions: (v1.0)
- *   add,  addi, and,  andi, auipc,
- *   beq,  bne,  jal,  jalr, lb,
- *   lbu,  lw,   lui,  nop,  or,
- *   ori,  sb,   slli, slt,  sltu,
- *   srai, srli, sub,  sw,   xor,
- *   ecall
+ * Instructions: (v1.1)
+ *   RV32I: add,   addi,  and,   andi,  auipc,
+ *          beq,   bge,   bgeu,  blt,   bltu,
+ *          bne,   fence, jal,   jalr,  lb,
+ *          lbu,   lh,    lhu,   lw,    lui,
+ *          or,    ori,   sb,    sh,    sll,
+ *          slli,  slt,   slti,  sltiu, sltu,
+ *          sra,   srai,  srl,   srli,  sub,
+ *          sw,    xor,   xori,  ecall
+ *   RV32M: mul, mulh, mulhsu, mulhu, div, divu, rem, remu
  */
 #include "riscvcommands.cpp"
 
+// Definido em threaded.cpp
+void h_decode(Hart &h, const DecodedInstr &d);
+// Definidos em jit.cpp
+void jit_invalidate(JitState *jit, uint32_t index);
+void jit_release(JitState *jit);
+// Definido em profile.cpp
+void profile_release(Profile *p);
+// Definido em trace.cpp
+void trace_release(Trace *t);
+// Definido em cache.cpp
+void cache_release(CacheModel *m);
+// Definido em pipeline.cpp
+void pipeline_release(Pipeline *p);
+// Definido em rvc.cpp
+uint32_t rvc_expand(uint32_t c);
+// Definido em syscalls.cpp
+void close_files(Hart &h);
+
+Hart::Hart()
+    : instret_limit(UINT64_MAX),
+      exit_code(0),
+      brk(0x3000),
+      jit(nullptr),
+      profile(nullptr),
+      trace(nullptr),
+      cache(nullptr),
+      pipeline(nullptr),
+      stores(nullptr),
+      smp(nullptr),
+      debugger(nullptr) {
+  for (int i = 0; i < 32; i++) {
+    breg[i] = 0;
+  }
+  mem_init(&mem);
+  mem.report = [](void *owner, const char *text) {
+    static_cast<Hart *>(owner)->print(text);
+  };
+  mem.owner = this;
+  mem_map(&mem, 0, MEM_SIZE * 4);
+  // layout compacto do RARS (heap em 0x3000), o load_elf() troca estes
+  // valores
+  entry = 0;
+  sp = 0x3ffc;
+  gp = 0x1800;
+  init();
+  set_text(0, DATA_SEGMENT_START);
+}
+
+Hart::~Hart() {
+  jit_release(jit);
+  profile_release(profile);
+  trace_release(trace);
+  cache_release(cache);
+  pipeline_release(pipeline);
+  close_files(*this);
+  mem_release(&mem);
+}
+
 //
 // Initial values for registers
 //
-void init() {
-  pc = 0;
+void Hart::init() {
+  pc = entry;
   ri = 0;
   has_jumped = false;
   stop_prg = false;
-  sp = 0x3ffc;
-  gp = 0x1800;
-  build_dic();
+  breg[SP] = sp;
+  breg[GP] = gp;
+  instret = 0;
+  exit_reason = EXIT_RUNNING;
+  exit_code = 0;
+  reserved = false;
 }
 
 // Imprime conteudo do banco de registradores
 //
-void dump_breg() {
+void Hart::dump_breg(FILE *out) {
   for (int i = 0; i < 32; i++) {
     if (i % 4 == 0) {
-      printf("---------------------------------\n");
+      fprintf(out, "---------------------------------\n");
     }
-    printf("|%s =\t%8d\t%8x|\n", reg_str[i].c_str(), breg[i], breg[i]);
+    fprintf(out, "|%s =\t%8d\t%8x|\n", reg_str[i], breg[i], breg[i]);
   }
-  printf("---------------------------------\n");
+  fprintf(out, "---------------------------------\n");
 }
 
-// Carrega um arquivo binario para a memoria
+// Carrega um arquivo binario para a memoria (ver mem_load_file). O heap
+// comeca depois dele se ele passar do inicio do heap. Devolve o numero de
+// palavras carregadas.
 //
-int load_mem(const char *fn, int start) {
-  FILE *fptr;
-  int *m_ptr = mem + (start >> 2);
-  int size = 0;
-
-  fptr = fopen(fn, "rb");
-  if (!fptr) {
+int Hart::load_mem(const char *fn, uint32_t start) {
+  int64_t size = mem_load_file(&mem, fn, start);
+  if (size < 0) {
     printf("Arquivo nao encontrado!\n");
     return -1;
-  } else {
-    while (!feof(fptr)) {
-      fread(m_ptr, 4, 1, fptr);
-      m_ptr++;
-      size++;
-    }
-    fclose(fptr);
   }
-  return size;
+  uint64_t end = (start + size + PAGE_BYTES - 1) & ~(uint64_t)(PAGE_BYTES - 1);
+  brk = max<uint64_t>(brk, min<uint64_t>(end, ALLONE));
+  return (size + 3) / 4;
 }
 
-// Determina o formato da intrucao
+// Define o segmento de texto e refaz a cache de instrucoes decodificadas
 //
-FORMATS get_i_format(uint32_t opcode, uint32_t func3, uint32_t func7) {
-  switch (opcode) {
-    case 0x33:
-      return RType;
-    case 0x03:
-    case 0x13:
-    case 0x67:
-    case 0x73:
-      return IType;
-    case 0x23:
-      return SType;
-    case 0x63:
-      return SBType;
-    case 0x37:
-    case 0x17:
-      return UType;
-    case 0x6F:
-      return UJType;
-    case 0x00:
-      if (func3 == 0 && func7 == 0) {
-        return NOPType;
-      } else {
-        return NullFormat;
+void Hart::set_text(uint32_t start, uint32_t size) {
+  text_start = start;
+  text_size = size & ~1u;
+  decoded_cache.resize(text_size >> 1);
+  clear_decoded();
+}
+
+/****************************** TABELA DE DECODE *****************************/
+
+// O decode e uma tabela de dois niveis, gerada de instr_info em tempo de
+// compilacao. O primeiro nivel e indexado pelo opcode e da o formato da
+// instrucao e a tabela de segundo nivel, indexada pelo funct3 e pela classe
+// do funct7. Encodings que nao existem ficam com I_nop.
+
+// Classe do funct7. Quem nao depende do funct7 (o campo faz parte do
+// imediato) tem a mesma instrucao em todas as classes.
+enum FUNCT7_CLASS { F7_ZERO, F7_ALT, F7_MULDIV, F7_OTHER, F7_CLASSES };
+
+constexpr uint8_t funct7_class_of(int funct7) {
+  return funct7 == 0x00 ? F7_ZERO
+         : funct7 == 0x20 ? F7_ALT
+         : funct7 == MULDIV7 ? F7_MULDIV
+                             : F7_OTHER;
+}
+
+enum { DECODE_TABLES = 16 };
+
+struct Decoder {
+  FORMATS format[128];  // por opcode
+  int8_t table[128];    // tabela de segundo nivel do opcode, -1 se invalido
+  INSTRUCTIONS tables[DECODE_TABLES][8][F7_CLASSES];
+  uint8_t funct7_class[128];
+  // As atomicas (extensao A) ficam fora da tabela de segundo nivel: elas sao
+  // indexadas pelo funct5, ja que os dois bits de baixo do funct7 sao aq e
+  // rl.
+  INSTRUCTIONS amo[32];
+};
+
+constexpr Decoder build_decoder() {
+  Decoder d{};
+  for (int i = 0; i < 128; i++) {
+    d.format[i] = NullFormat;
+    d.table[i] = -1;
+    d.funct7_class[i] = funct7_class_of(i);
+  }
+  for (int i = 0; i < 32; i++) {
+    d.amo[i] = I_nop;
+  }
+  int used = 0;
+  for (int i = 0; i < I_nop; i++) {
+    const InstrInfo &info = instr_info[i];
+    if (d.table[info.opcode] < 0) {
+      // cria a tabela de segundo nivel do opcode, toda invalida
+      d.format[info.opcode] = info.format;
+      d.table[info.opcode] = used;
+      for (int f3 = 0; f3 < 8; f3++) {
+        for (int c = 0; c < F7_CLASSES; c++) {
+          d.tables[used][f3][c] = I_nop;
+        }
+      }
+      used++;
+    }
+    if (info.opcode == AMO) {
+      d.amo[info.funct7] = info.id;
+      continue;
+    }
+    for (int f3 = 0; f3 < 8; f3++) {
+      for (int c = 0; (info.funct3 & F3(f3)) && c < F7_CLASSES; c++) {
+        if (info.funct7 == F7_ANY || c == funct7_class_of(info.funct7)) {
+          d.tables[d.table[info.opcode]][f3][c] = info.id;
+        }
       }
+    }
+  }
+  return d;
+}
+
+constexpr Decoder decoder = build_decoder();
+
+// Instrucao de uma palavra, sem imprimir nada. I_nop se ela nao existe.
+//
+INSTRUCTIONS decode_lookup(uint32_t word) {
+  int table = decoder.table[word & 0x7F];
+  if (table < 0) {
+    return I_nop;
+  }
+  if ((word & 0x7F) == AMO) {
+    return ((word >> 12) & 0x7) == AMOW3 ? decoder.amo[word >> 27] : I_nop;
+  }
+  INSTRUCTIONS code = decoder.tables[table][(word >> 12) & 0x7]
+                                     [decoder.funct7_class[word >> 25]];
+  // o ecall e uma palavra so; o ebreak e os outros SYSTEM com funct3 0, nao
+  return code == I_ecall && (word >> 7) != 0 ? I_nop : code;
+}
+
+// Imediato de uma palavra, do tipo kind (instr_info[].imm). Usado pelo
+// decode() e pelo desmontador (disasm.cpp).
+//
+constexpr int32_t instr_imm(uint32_t word, IMMEDIATES kind) {
+  int32_t sign = (int32_t)(word & 0x80000000);  // so o bit 31
+  switch (kind) {
+    case IMM_I:
+      return (int32_t)word >> 20;
+    case IMM_S:
+      return ((int32_t)(word & 0xFE000000) >> 20) | ((word >> 7) & 0x1F);
+    case IMM_B:
+      return (sign >> 19) | ((word << 4) & 0x800) | ((word >> 20) & 0x7E0) |
+             ((word >> 7) & 0x1E);
+    case IMM_U:
+      return word >> 12;
+    case IMM_J:
+      return (sign >> 11) | (word & 0xFF000) | ((word >> 9) & 0x800) |
+             ((word >> 20) & 0x7FE);
+    case IMM_SHAMT:
+      return (word >> 20) & 0x1F;
     default:
-      cout << "Undefined Format";
-      return NullFormat;
+      return 0;
   }
 }
 
+static_assert(instr_imm(0xFE512A23, IMM_S) == -12, "imediato S");  // sw
+static_assert(instr_imm(0xFE000EE3, IMM_B) == -4, "imediato B");   // beq
+static_assert(instr_imm(0xFF9FF06F, IMM_J) == -8, "imediato J");   // jal
+
+// Determina o formato da intrucao
+//
+FORMATS Hart::get_i_format(uint32_t opcode) {
+  return decoder.format[opcode & 0x7F];
+}
+
 // Determina a instrucao a ser executada
+//
+INSTRUCTIONS Hart::get_instr_code(uint32_t word) {
+  INSTRUCTIONS code = decode_lookup(word);
+  if (code == I_nop) {
+    char text[64];
+    snprintf(text, sizeof(text),
+             "Instrucao Invalida (PC = %08x RI = %08x)\n", pc, ri);
+    print(text);
+  }
+  return code;
+}
 
-INSTRUCTIONS get_instr_code(uint32_t opcode, uint32_t func3, uint32_t func7) {
-  switch (opcode) {
-    case LUI:
-      return I_lui;
-    case AUIPC:
-      return I_auipc;
-    case BType:
-      switch (func3) {
-        case BEQ3:
-          return I_beq;
-        case BNE3:
-          return I_bne;
-        case BGE3:
-          return I_bge;
-        case BGEU3:
-          return I_bgeu;
-        case BLT3:
-          return I_blt;
-        case BLTU3:
-          return I_bltu;
-      }
-      break;
-    case ILType:
-      switch (func3) {
-        case LB3:
-          return I_lb;
-        case LW3:
-          return I_lw;
-        case LBU3:
-          return I_lbu;
-        default:
-          break;
-      }
-      break;
-    case JAL:
-      return I_jal;
-    case JALR:
-      return I_jalr;
-    case StoreType:
-      switch (func3) {
-        case SB3:
-          return I_sb;
-        case SW3:
-          return I_sw;
-        default:
-          break;
-      }
-      break;
-    case ILAType:
-      switch (func3) {
-        case ADDI3:
-          return I_addi;
-        case SLLI3:
-          return I_slli;
-        case SRAI3:
-          if (func7 == SRLI7) {
-            return I_srli;
-          } else {
-            return I_srai;
-          }
-        case ORI3:
-          return I_ori;
-        case ANDI3:
-          return I_andi;
-        default:
-          break;
-      }
-      break;
-    case RegType:
-      switch (funct3) {
-        case ADDSUB3:
-          if (func7 == SUB7) {
-            return I_sub;
-          } else {
-            return I_add;
-          }
-        case SLL3:
-          return I_sll;
-        case SLT3:
-          return I_slt;
-        case SLTU3:
-          return I_sltu;
-        case XOR3:
-          return I_xor;
-        case OR3:
-          return I_or;
-        case AND3:
-          return I_and;
-        case SR3:
-          if (func7 == SRA7) {
-            return I_sra;
-          } else {
-            return I_srl;
-          }
-        default:
-          break;
+// Invalida as entradas da cache afetadas por uma escrita na palavra que
+// contem address: as duas meias palavras dela e a anterior, que pode ser o
+// inicio de uma instrucao de 32 bits que termina nesta palavra. As duas
+// entradas antes destas podem estar fundidas com uma delas (threaded.cpp) e
+// voltam para o h_decode, sem perder o decode.
+//
+void Hart::invalidate_decoded(uint32_t address) {
+  uint32_t word = address & ~3u;
+  if (word + 2 - text_start >= text_size + 8) {
+    return;  // nenhuma das cinco meias palavras esta no texto
+  }
+  for (uint32_t a = word - 6; a != word - 2; a += 2) {
+    if (in_text(a) && decoded(a).fused) {
+      decoded(a).fused = false;
+      decoded(a).handler = h_decode;
+    }
+  }
+  for (uint32_t a = word - 2; a != word + 4; a += 2) {
+    if (in_text(a)) {
+      decoded(a).valid = false;
+      decoded(a).fused = false;
+      decoded(a).handler = h_decode;
+      if (jit != nullptr) {
+        jit_invalidate(jit, (a - text_start) >> 1);
       }
-      break;
-    case ECALL:
-      return I_ecall;
-    default:
-      printf("Instrucao Invalida (PC = %08x RI = %08x)\n", pc, ri);
-      break;
+    }
+  }
+}
+
+// Invalida as entradas de [address, address + size), para as escritas em
+// bloco dos ecalls
+//
+void Hart::invalidate_decoded(uint32_t address, uint32_t size) {
+  uint64_t begin = max<uint64_t>(address & ~3u, text_start);
+  uint64_t end = min<uint64_t>((uint64_t)address + size,
+                               (uint64_t)text_start + text_size);
+  for (uint64_t a = begin; a < end; a += 4) {
+    invalidate_decoded(a);
   }
-  return I_nop;
 }
 
-// Instrucao decodificada
+// Limpa toda a cache, usado quando um novo programa e carregado
 //
-INSTRUCTIONS instruction;
+void Hart::clear_decoded() {
+  for (DecodedInstr &d : decoded_cache) {
+    d.valid = false;
+    d.fused = false;
+    d.handler = h_decode;
+  }
+}
 
 /************************************ FETCH **********************************/
-void fetch() { ri = lw(pc, 0); }
+
+// Le a instrucao em address. As comprimidas (bits 1:0 diferentes de 11) sao
+// expandidas para a instrucao de 32 bits equivalente (ver rvc.cpp). size
+// recebe o tamanho dela na memoria.
+//
+uint32_t Hart::read_instr(uint32_t address, uint32_t &size) {
+  uint32_t low = lhu(address, 0);
+  if ((low & 3) != 3) {
+    size = 2;
+    return rvc_expand(low);
+  }
+  size = 4;
+  return low | (uint32_t)lhu(address + 2, 0) << 16;
+}
+
+void Hart::fetch() { ri = read_instr(pc, ilen); }
 
 /*********************************** DECODE **********************************/
 
-void decode() {
-  int32_t tmp;
-  opcode = ri & 0x7F;             // codigo da instrucao
-  rs2 = (ri >> 20) & 0x1F;        // segundo operando
-  rs1 = (ri >> 15) & 0x1F;        // primeiro operando
-  rd = (ri >> 7) & 0x1F;          // registrador destino
-  shamt = (ri >> 20) & 0x1F;      // deslocamento
-  funct3 = (ri >> 12) & 0x7;      // auxiliar codigo instrucao
-  funct7 = (ri >> 25);            // auxiliar codigo de instrucao
-  imm12_i = ((int32_t)ri) >> 20;  // imediato 12 bits
-  tmp = get_field(ri, 7, 0x1f);
-  imm12_s = set_field(imm12_i, 0, 0x1f, tmp);
-  imm13 = imm12_s;
-  imm13 = set_bit(imm13, 11, imm12_s & 1);
-  imm13 = imm13 & ~1;
-  imm20_u = (unsigned)(ri & (~0xFFF)) >> 12;
-  // mais aborrecido: imediato 21 bits
-  imm21 = (int32_t)ri >> 11;                // estende sinal
-  tmp = get_field(ri, 12, 0xFF);            // le campo 19:12
-  imm21 = set_field(imm21, 12, 0xFF, tmp);  // escreve campo em imm21
-  tmp = get_bit(ri, 20);                    // le o bit 11 em ri(20)
-  imm21 = set_bit(imm21, 11, tmp);          // posiciona bit 11
-  tmp = get_field(ri, 21, 0x3FF);
-  imm21 = set_field(imm21, 1, 0x3FF, tmp);
-  imm21 = imm21 & ~1;  // zera bit 0
-
-  instruction = get_instr_code(opcode, funct3, funct7);
-  imm32_t = *imediatos[get_i_format(opcode, funct3, funct7)];
+void Hart::decode() {
+  opcode = ri & 0x7F;         // codigo da instrucao
+  rs2 = (ri >> 20) & 0x1F;    // segundo operando
+  rs1 = (ri >> 15) & 0x1F;    // primeiro operando
+  rd = (ri >> 7) & 0x1F;      // registrador destino
+  shamt = (ri >> 20) & 0x1F;  // deslocamento
+  funct3 = (ri >> 12) & 0x7;  // auxiliar codigo instrucao
+  funct7 = (ri >> 25);        // auxiliar codigo de instrucao
+  instruction = get_instr_code(ri);
+  imm32_t = instr_imm(ri, instr_info[instruction].imm);
 }
 
-void execute() {
+void Hart::execute() {
   switch (instruction) {
     case I_add:
       rADD(rd, rs1, rs2);
       break;
     case I_addi:
-      iADDI(rd, rs1, imm12_i);
+      iADDI(rd, rs1, imm32_t);
       break;
     case I_and:
       rAND(rd, rs1, rs2);
       break;
     case I_andi:
-      iANDI(rd, rs1, imm12_i);
+      iANDI(rd, rs1, imm32_t);
       break;
     case I_auipc:
-      uAUIPC(rd, imm20_u);
+      uAUIPC(rd, imm32_t);
       break;
     case I_beq:
-      sbBEQ(rs1, rs2, imm13);
+      sbBEQ(rs1, rs2, imm32_t);
       break;
     case I_bne:
-      sbBNE(rs1, rs2, imm13);
+      sbBNE(rs1, rs2, imm32_t);
       break;
     case I_bge:
-      sbBGE(rs1, rs2, imm13);
+      sbBGE(rs1, rs2, imm32_t);
       break;
     case I_bgeu:
-      sbBGEU(rs1, rs2, imm13);
+      sbBGEU(rs1, rs2, imm32_t);
       break;
     case I_blt:
-      sbBLT(rs1, rs2, imm13);
+      sbBLT(rs1, rs2, imm32_t);
       break;
     case I_bltu:
-      sbBLTU(rs1, rs2, imm13);
+      sbBLTU(rs1, rs2, imm32_t);
       break;
     case I_jal:
-      ujJAL(rd, imm21);
+      ujJAL(rd, imm32_t);
       break;
     case I_jalr:
-      ujJALR(rd, rs1, imm12_i);
+      ujJALR(rd, rs1, imm32_t);
       break;
     case I_lb:
-      iLB(rd, rs1, imm12_i);
+      iLB(rd, rs1, imm32_t);
       break;
     case I_or:
       rOR(rd, rs1, rs2);
       break;
     case I_lbu:
-      iLBU(rd, rs1, imm12_i);
+      iLBU(rd, rs1, imm32_t);
       break;
     case I_lw:
-      iLW(rd, rs1, imm12_i);
+      iLW(rd, rs1, imm32_t);
       break;
     case I_lui:
-      uLUI(rd, imm20_u);
+      uLUI(rd, imm32_t);
       break;
     case I_nop:
       pseudoNOP();
@@ -301,61 +406,268 @@ void execute() {
       rSLTU(rd, rs1, rs2);
       break;
     case I_ori:
-      iORI(rd, rs1, imm12_i);
+      iORI(rd, rs1, imm32_t);
       break;
     case I_sb:
-      sSB(rs1, rs2, imm12_s);
+      sSB(rs1, rs2, imm32_t);
       break;
     case I_slli:
-      iSLLI(rd, rs1, shamt);
+      iSLLI(rd, rs1, imm32_t);
       break;
     case I_slt:
       rSLT(rd, rs1, rs2);
       break;
     case I_srai:
-      iSRAI(rd, rs1, shamt);
+      iSRAI(rd, rs1, imm32_t);
       break;
     case I_srli:
-      iSRLI(rd, rs1, shamt);
+      iSRLI(rd, rs1, imm32_t);
       break;
     case I_sub:
       rSUB(rd, rs1, rs2);
       break;
     case I_sw:
-      sSW(breg[rs1], breg[rs2], imm12_s);
+      sSW(breg[rs1], breg[rs2], imm32_t);
       break;
     case I_xor:
       rXOR(rd, rs1, rs2);
       break;
+    case I_lh:
+      iLH(rd, rs1, imm32_t);
+      break;
+    case I_lhu:
+      iLHU(rd, rs1, imm32_t);
+      break;
+    case I_sh:
+      sSH(rs1, rs2, imm32_t);
+      break;
+    case I_slti:
+      iSLTI(rd, rs1, imm32_t);
+      break;
+    case I_sltiu:
+      iSLTIU(rd, rs1, imm32_t);
+      break;
+    case I_xori:
+      iXORI(rd, rs1, imm32_t);
+      break;
+    case I_sll:
+      rSLL(rd, rs1, rs2);
+      break;
+    case I_srl:
+      rSRL(rd, rs1, rs2);
+      break;
+    case I_sra:
+      rSRA(rd, rs1, rs2);
+      break;
+    case I_fence:
+      iFENCE();
+      break;
+    case I_mul:
+      rMUL(rd, rs1, rs2);
+      break;
+    case I_mulh:
+      rMULH(rd, rs1, rs2);
+      break;
+    case I_mulhsu:
+      rMULHSU(rd, rs1, rs2);
+      break;
+    case I_mulhu:
+      rMULHU(rd, rs1, rs2);
+      break;
+    case I_div:
+      rDIV(rd, rs1, rs2);
+      break;
+    case I_divu:
+      rDIVU(rd, rs1, rs2);
+      break;
+    case I_rem:
+      rREM(rd, rs1, rs2);
+      break;
+    case I_remu:
+      rREMU(rd, rs1, rs2);
+      break;
     case I_ecall:
       stop_prg = sysECALL();
       break;
+    case I_lr_w:
+      rLRW(rd, rs1);
+      break;
+    case I_sc_w:
+      rSCW(rd, rs1, rs2);
+      break;
+    case I_amoswap_w:
+    case I_amoadd_w:
+    case I_amoxor_w:
+    case I_amoand_w:
+    case I_amoor_w:
+    case I_amomin_w:
+    case I_amomax_w:
+    case I_amominu_w:
+    case I_amomaxu_w:
+      rAMOW(instruction, rd, rs1, rs2);
+      break;
     default:
-      printf("Comando não reconhecido...\n");
+      print("Comando não reconhecido...\n");
       break;
   }
 }
 
-void step() {
+// Busca a instrucao ja decodificada na cache. Na primeira vez que o PC e
+// visto faz o fetch/decode completo e guarda o resultado. Instrucoes invalidas
+// nao sao guardadas para que o erro continue aparecendo a cada execucao.
+// Se o fetch faltar nada e decodificado.
+//
+void Hart::fetch_decoded() {
+  if ((pc & 1) != 0 || !in_text(pc)) {
+    fetch();
+    if (!mem.fault) {
+      decode();
+    }
+    return;
+  }
+  DecodedInstr &d = decoded(pc);
+  if (d.valid) {
+    instruction = d.instruction;
+    rd = d.rd;
+    rs1 = d.rs1;
+    rs2 = d.rs2;
+    imm32_t = d.imm;
+    ilen = d.size;
+    return;
+  }
   fetch();
+  if (mem.fault) {
+    return;
+  }
   decode();
+  d.instruction = instruction;
+  d.rd = rd;
+  d.rs1 = rs1;
+  d.rs2 = rs2;
+  d.imm = imm32_t;
+  d.size = ilen;
+  d.valid = instruction != I_nop;
+}
+
+void Hart::step() {
+  instret++;
+  fetch_decoded();
+  if (mem.fault) {
+    return;
+  }
+  retire();
+}
+
+// Executa a instrucao ja decodificada e avanca o PC. Separado do step() para
+// o trace poder olhar os registradores entre o decode e o execute.
+//
+void Hart::retire() {
   execute();
   breg[ZERO] = 0;
+  if (mem.fault) {
+    return;  // o PC fica na instrucao que fez o acesso
+  }
   if (has_jumped) {
     has_jumped = false;
   } else {
-    pc = pc + 4;
+    pc = pc + ilen;
+  }
+}
+
+// Registra o motivo do fim da execucao, imprime a mensagem, igual a do RARS,
+// e esvazia o console
+//
+void Hart::report_finish() {
+  if (mem.fault) {
+    exit_reason = EXIT_FAULT;
+    char text[96];
+    snprintf(text, sizeof(text),
+             "\nErro: acesso a endereco nao mapeado %08x (PC = %08x)\n",
+             mem.fault_address, pc);
+    print(text);
+    print("\n-- program is finished running (memory fault) --\n");
+  } else if (exit_reason == EXIT_SNAPSHOT) {
+    print("\n-- program is finished running (snapshot) --\n");
+  } else if (stop_prg) {
+    exit_reason = EXIT_ECALL;
+    char text[64];
+    snprintf(text, sizeof(text), "\n-- program is finished running (%d) --\n",
+             exit_code);
+    print(text);
+  } else if (instret >= instret_limit) {
+    exit_reason = EXIT_LIMIT;
+    print("\n-- program is finished running (instruction limit) --\n");
+  } else {
+    exit_reason = EXIT_DROPPED_OFF;
+    print("\n-- program is finished running (dropped off bottom) --\n");
   }
+  console.flush();
 }
 
-void run() {
+// Motor de referencia: fetch/decode/execute com o switch do execute()
+//
+void Hart::run() {
   init();
-  while ((pc < DATA_SEGMENT_START) && !stop_prg) {
+  clear_decoded();
+  resume();
+  report_finish();
+}
+
+// Laco do motor de referencia, que continua de onde o hart parou. Separado
+// do run() para a comparacao com a referencia (lockstep.cpp) rodar o motor
+// aos poucos.
+//
+void Hart::resume() {
+  while (running()) {
     step();
   }
-  if (stop_prg) {
-    printf("\n-- program is finished running (0) --\n");
-  } else {
-    printf("\n-- program is finished running (dropped off bottom) --\n");
+}
+
+// Prepara o hart para o motor, como o inicio do run_*() dele, para quem roda
+// o motor aos poucos com resume_engine() (lockstep.cpp, smp.cpp). Devolve o
+// motor que vai de fato rodar.
+//
+ENGINES Hart::start_engine(ENGINES engine) {
+  if (engine == E_JIT && start_jit()) {
+    return E_JIT;
+  }
+  if (engine == E_JIT) {
+    printf("JIT indisponivel, usando o motor threaded\n");
+    engine = E_THREADED;
+  }
+  init();
+  clear_decoded();
+  return engine;
+}
+
+// Continua a execucao no motor ate o running() ficar falso
+//
+void Hart::resume_engine(ENGINES engine) {
+  switch (engine) {
+    case E_SWITCH:
+      resume();
+      break;
+    case E_THREADED:
+      resume_threaded();
+      break;
+    case E_JIT:
+      resume_jit();
+      break;
   }
 }
+
+/*************************** PONTO DE ENTRADA GLOBAL **************************/
+
+// Processador usado pelo main.exe quando roda um programa so
+//
+Hart hart;
+
+int load_mem(const char *fn, uint32_t start) {
+  return hart.load_mem(fn, start);
+}
+
+bool load_elf(const char *fn) { return hart.load_elf(fn); }
+
+void dump_breg() { hart.dump_breg(); }
+
+void run() { hart.run(); }
@@ -1,5 +1,7 @@
 #include "acessoMemoriaRV.c"
 #include "globals.h"
+#include "console.h"
+#include "hart.h"
 
 /**
  * Função ADD do tipo R. Adiciona os dois valores de registradores e guarda em
@@ -9,7 +11,7 @@
  * @param output Endereço de registrador que recebe o resultado.
  * @return A soma feita.
  */
-int32_t rADD(int output, int input1, int input2) {
+int32_t Hart::rADD(int output, int input1, int input2) {
   int32_t result = breg[input1] + breg[input2];
   breg[output] = result;
   return result;
@@ -23,7 +25,7 @@ int32_t rADD(int output, int input1, int input2) {
  * @param output Endereço de registrador que recebe o resultado.
  * @return A soma feita.
  */
-int32_t iADDI(int output, int input1, int32_t immediate) {
+int32_t Hart::iADDI(int output, int input1, int32_t immediate) {
   int32_t result = breg[input1] + immediate;
   breg[output] = result;
   return result;
@@ -36,7 +38,7 @@ int32_t iADDI(int output, int input1, int32_t immediate) {
  * @param input2 Segundo endereço de registrador a ser comparado.
  * @return A comparação feita.
  */
-int32_t rAND(int output, int input1, int input2) {
+int32_t Hart::rAND(int output, int input1, int input2) {
   int32_t result = breg[input1] & breg[input2];
   breg[output] = result;
   return result;
@@ -49,7 +51,7 @@ int32_t rAND(int output, int input1, int input2) {
  * @param immediate Imediato com o número a ser comparado.
  * @return A comparação feita.
  */
-int32_t iANDI(int output, int input1, int32_t immediate) {
+int32_t Hart::iANDI(int output, int input1, int32_t immediate) {
   int32_t result = breg[input1] & immediate;
   breg[output] = result;
   return result;
@@ -61,7 +63,7 @@ int32_t iANDI(int output, int input1, int32_t immediate) {
  * @param immediate Imediato usado pra somar com o endereço de PC.
  * @return O endereço somado.
  */
-uint32_t uAUIPC(int output, uint32_t immediate) {
+uint32_t Hart::uAUIPC(int output, uint32_t immediate) {
   uint32_t result = pc + (immediate << 12);
   breg[output] = result;
   return result;
@@ -74,7 +76,7 @@ uint32_t uAUIPC(int output, uint32_t immediate) {
  * @param input2 Segundo endereço de registrador a ser comparado.
  * @param label Comando para o qual o endereço será redirecionado.
  */
-void sbBEQ(int input1, int input2, int label) {
+void Hart::sbBEQ(int input1, int input2, int label) {
   if (breg[input1] == breg[input2]) {
     pc += label;
     has_jumped = true;
@@ -88,7 +90,7 @@ void sbBEQ(int input1, int input2, int label) {
  * @param input2 Segundo endereço de registrador a ser comparado.
  * @param label Comando para o qual o endereço será redirecionado.
  */
-void sbBNE(int input1, int input2, int label) {
+void Hart::sbBNE(int input1, int input2, int label) {
   if (breg[input1] != breg[input2]) {
     pc += label;
     has_jumped = true;
@@ -102,7 +104,7 @@ void sbBNE(int input1, int input2, int label) {
  * @param input2 Segundo endereço de registrador a ser comparado.
  * @param label Comando para o qual o endereço será redirecionado.
  */
-void sbBGE(int input1, int input2, int label) {
+void Hart::sbBGE(int input1, int input2, int label) {
   if (breg[input1] >= breg[input2]) {
     pc += label;
     has_jumped = true;
@@ -116,7 +118,7 @@ void sbBGE(int input1, int input2, int label) {
  * @param input2 Segundo endereço de registrador a ser comparado (unsigned).
  * @param label Comando para o qual o endereço será redirecionado.
  */
-void sbBGEU(int input1, int input2, int label) {
+void Hart::sbBGEU(int input1, int input2, int label) {
   if ((unsigned)breg[input1] >= (unsigned)breg[input2]) {
     pc += label;
     has_jumped = true;
@@ -130,7 +132,7 @@ void sbBGEU(int input1, int input2, int label) {
  * @param input2 Segundo endereço de registrador a ser comparado.
  * @param label Comando para o qual o endereço será redirecionado.
  */
-void sbBLT(int input1, int input2, int label) {
+void Hart::sbBLT(int input1, int input2, int label) {
   if (breg[input1] < breg[input2]) {
     pc += label;
     has_jumped = true;
@@ -144,7 +146,7 @@ void sbBLT(int input1, int input2, int label) {
  * @param input2 Segundo endereço de registrador a ser comparado (unsigned).
  * @param label Comando para o qual o endereço será redirecionado.
  */
-void sbBLTU(int input1, int input2, int label) {
+void Hart::sbBLTU(int input1, int input2, int label) {
   if ((unsigned)breg[input1] < (unsigned)breg[input2]) {
     pc += label;
     has_jumped = true;
@@ -157,8 +159,8 @@ void sbBLTU(int input1, int input2, int label) {
  * @param link Onde é guardado o endereço antigo do PC.
  * @param target Endereço de instrução novo para o qual se quer pular.
  */
-void ujJAL(int link, int target) {
-  breg[link] = pc + 4;
+void Hart::ujJAL(int link, int target) {
+  breg[link] = pc + ilen;
   pc += target;
   has_jumped = true;
 }
@@ -171,9 +173,11 @@ void ujJAL(int link, int target) {
  * quer pular.
  * @param immediate Offset do endereço para o qual se quer pular.
  */
-void ujJALR(int link, int target, int immediate) {
-  breg[link] = pc + 4;
-  pc = breg[target] + immediate;
+void Hart::ujJALR(int link, int target, int immediate) {
+  // le antes, link pode ser rs1; o bit 0 do destino e sempre zerado
+  uint32_t address = (breg[target] + immediate) & ~1u;
+  breg[link] = pc + ilen;
+  pc = address;
   has_jumped = true;
 }
 
@@ -185,9 +189,11 @@ void ujJALR(int link, int target, int immediate) {
  * @param kte Offset do endereço.
  * @return O byte encontrado.
  */
-int32_t iLB(int output, uint32_t address, int32_t kte) {
+int32_t Hart::iLB(int output, uint32_t address, int32_t kte) {
   int32_t byte = lb(breg[address], kte);
-  breg[output] = byte;
+  if (!mem.fault) {  // a falta descarta o acesso, rd nao muda
+    breg[output] = byte;
+  }
   return byte;
 }
 
@@ -198,7 +204,7 @@ int32_t iLB(int output, uint32_t address, int32_t kte) {
  * @param output Endereço de registrador que recebe o resultado.
  * @return A comparação feita.
  */
-int32_t rOR(int output, int input1, int input2) {
+int32_t Hart::rOR(int output, int input1, int input2) {
   int32_t result = breg[input1] | breg[input2];
   breg[output] = result;
   return result;
@@ -212,9 +218,11 @@ int32_t rOR(int output, int input1, int input2) {
  * @param kte Offset do endereço.
  * @return O byte encontrado.
  */
-int32_t iLBU(int output, uint32_t address, int32_t kte) {
+int32_t Hart::iLBU(int output, uint32_t address, int32_t kte) {
   int32_t byte = lbu(breg[address], kte);
-  breg[output] = byte;
+  if (!mem.fault) {
+    breg[output] = byte;
+  }
   return byte;
 }
 
@@ -226,9 +234,11 @@ int32_t iLBU(int output, uint32_t address, int32_t kte) {
  * @param kte Offset do endereço.
  * @return A palavra encontrada.
  */
-int32_t iLW(int output, uint32_t address, int32_t kte) {
+int32_t Hart::iLW(int output, uint32_t address, int32_t kte) {
   int32_t word = lw(breg[address], kte);
-  breg[output] = word;
+  if (!mem.fault) {
+    breg[output] = word;
+  }
   return word;
 }
 
@@ -238,7 +248,7 @@ int32_t iLW(int output, uint32_t address, int32_t kte) {
  * @param immediate Número a ser shiftado.
  * @result Número shiftado.
  */
-int32_t uLUI(int output, int immediate) {
+int32_t Hart::uLUI(int output, int immediate) {
   int32_t result = immediate << 12;
   breg[output] = result;
   return result;
@@ -247,7 +257,7 @@ int32_t uLUI(int output, int immediate) {
 /**
  * Pseudo função NOP. Não faz operação alguma.
  */
-void pseudoNOP() { iADDI(0, 0, 0); }
+void Hart::pseudoNOP() { iADDI(0, 0, 0); }
 
 /**
  * Função SLTU do tipo R. Se o primeiro argumento é menor que o segundo, seta
@@ -257,7 +267,7 @@ void pseudoNOP() { iADDI(0, 0, 0); }
  * @param input2 Segundo endereço de registrador a ser comparado.
  * @result 1 se o primeiro registrador é menor que o segundo, senão 0.
  */
-int32_t rSLTU(int output, int input1, int input2) {
+int32_t Hart::rSLTU(int output, int input1, int input2) {
   uint reg1 = breg[input1];
   uint reg2 = breg[input2];
   int32_t result = reg1 < reg2 ? 1 : 0;
@@ -272,7 +282,7 @@ int32_t rSLTU(int output, int input1, int input2) {
  * @param immediate Segundo número a ser comparado.
  * @result Resultado da comparação.
  */
-int32_t iORI(int output, int input1, int immediate) {
+int32_t Hart::iORI(int output, int input1, int immediate) {
   int32_t result = breg[input1] | immediate;
   breg[output] = result;
   return result;
@@ -285,7 +295,7 @@ int32_t iORI(int output, int input1, int immediate) {
  * @param kte Offset do endereço.
  * @param dado Byte a ser salvo na memória.
  */
-void sSB(uint32_t address, int32_t dado, int32_t kte) {
+void Hart::sSB(uint32_t address, int32_t dado, int32_t kte) {
   int8_t byte = breg[dado] & BYTE1AND;
   sb(breg[address], kte, byte);
 }
@@ -298,7 +308,7 @@ void sSB(uint32_t address, int32_t dado, int32_t kte) {
  * @param immediate Número de vezes a ser shiftado.
  * @result O número shiftado.
  */
-int32_t iSLLI(int output, int input1, int immediate) {
+int32_t Hart::iSLLI(int output, int input1, int immediate) {
   int32_t result = breg[input1] << immediate;
   breg[output] = result;
   return result;
@@ -312,7 +322,7 @@ int32_t iSLLI(int output, int input1, int immediate) {
  * @param input2 Segundo endereço de registrador a ser comparado.
  * @result 1 se o primeiro registrador é menor que o segundo, senão 0.
  */
-int32_t rSLT(int output, int input1, int input2) {
+int32_t Hart::rSLT(int output, int input1, int input2) {
   int32_t result = breg[input1] < breg[input2] ? 1 : 0;
   breg[output] = result;
   return result;
@@ -326,7 +336,7 @@ int32_t rSLT(int output, int input1, int input2) {
  * @param immediate Quantidade de bits a ser shiftado.
  * @result Número shiftado.
  */
-int32_t iSRAI(int output, int input1, int immediate) {
+int32_t Hart::iSRAI(int output, int input1, int immediate) {
   int32_t result = breg[input1] >> immediate;
   breg[output] = result;
   return result;
@@ -340,7 +350,7 @@ int32_t iSRAI(int output, int input1, int immediate) {
  * @param immediate Quantidade de bits a ser shiftado.
  * @result Número shiftado.
  */
-int32_t iSRLI(int output, int input1, int immediate) {
+int32_t Hart::iSRLI(int output, int input1, int immediate) {
   uint32_t reg1 = breg[input1];
   int32_t result = reg1 >> immediate;
   breg[output] = result;
@@ -355,7 +365,7 @@ int32_t iSRLI(int output, int input1, int immediate) {
  * @param output Endereço de registrador que recebe o resultado.
  * @return A subtração feita.
  */
-int32_t rSUB(int output, int input1, int input2) {
+int32_t Hart::rSUB(int output, int input1, int input2) {
   int32_t result = breg[input1] - breg[input2];
   breg[output] = result;
   return result;
@@ -368,7 +378,7 @@ int32_t rSUB(int output, int input1, int input2) {
  * @param kte Offset do endereço.
  * @param dado Palavra a ser salva na memória.
  */
-void sSW(uint32_t address, int32_t dado, int32_t kte) {
+void Hart::sSW(uint32_t address, int32_t dado, int32_t kte) {
   sw(address, kte, dado);
 }
 
@@ -379,29 +389,439 @@ void sSW(uint32_t address, int32_t dado, int32_t kte) {
  * @param output Endereço de registrador que recebe o resultado.
  * @return A comparação feita.
  */
-int32_t rXOR(int output, int input1, int input2) {
+int32_t Hart::rXOR(int output, int input1, int input2) {
   int32_t result = breg[input1] ^ breg[input2];
   breg[output] = result;
   return result;
 }
 
 /**
- * Função ecall. Vê o comando em A7 e executa conforme.
- * @return Se a função chamar exit retorna true.
+ * Função LH do tipo I. Carrega meia palavra de um endereço, estendendo o
+ * sinal.
+ * @param output Endereço de registrador que recebe o resultado.
+ * @param address Registrador com o endereço da meia palavra.
+ * @param kte Offset do endereço.
+ * @return A meia palavra encontrada.
+ */
+int32_t Hart::iLH(int output, uint32_t address, int32_t kte) {
+  int32_t half = lh(breg[address], kte);
+  if (!mem.fault) {
+    breg[output] = half;
+  }
+  return half;
+}
+
+/**
+ * Função LHU do tipo I. Carrega meia palavra unsigned de um endereço.
+ * @param output Endereço de registrador que recebe o resultado.
+ * @param address Registrador com o endereço da meia palavra.
+ * @param kte Offset do endereço.
+ * @return A meia palavra encontrada.
+ */
+int32_t Hart::iLHU(int output, uint32_t address, int32_t kte) {
+  int32_t half = lhu(breg[address], kte);
+  if (!mem.fault) {
+    breg[output] = half;
+  }
+  return half;
+}
+
+/**
+ * Função SH do tipo S. Salva os 16 bits de baixo do registrador em um
+ * endereço.
+ * @param address Registrador com o endereço da meia palavra.
+ * @param dado Registrador com a meia palavra a ser salva.
+ * @param kte Offset do endereço.
+ */
+void Hart::sSH(uint32_t address, int32_t dado, int32_t kte) {
+  sh(breg[address], kte, breg[dado] & 0xFFFF);
+}
+
+/**
+ * Função SLTI do tipo I. Se o registrador é menor que o imediato, seta para 1,
+ * senão para 0.
+ * @param output Endereço de registrador que recebe o resultado.
+ * @param input1 Registrador a ser comparado.
+ * @param immediate Imediato a ser comparado.
+ * @result 1 se o registrador é menor que o imediato, senão 0.
+ */
+int32_t Hart::iSLTI(int output, int input1, int32_t immediate) {
+  int32_t result = breg[input1] < immediate ? 1 : 0;
+  breg[output] = result;
+  return result;
+}
+
+/**
+ * Função SLTIU do tipo I. Como a SLTI, mas compara sem sinal. O imediato tem o
+ * sinal estendido antes da comparação.
+ * @param output Endereço de registrador que recebe o resultado.
+ * @param input1 Registrador a ser comparado (unsigned).
+ * @param immediate Imediato a ser comparado (unsigned).
+ * @result 1 se o registrador é menor que o imediato, senão 0.
+ */
+int32_t Hart::iSLTIU(int output, int input1, int32_t immediate) {
+  int32_t result = (uint32_t)breg[input1] < (uint32_t)immediate ? 1 : 0;
+  breg[output] = result;
+  return result;
+}
+
+/**
+ * Função XORI do tipo I. Faz um xor bit a bit com o imediato.
+ * @param output Endereço de registrador que recebe o resultado.
+ * @param input1 Registrador a ser comparado.
+ * @param immediate Imediato a ser comparado.
+ * @return A comparação feita.
+ */
+int32_t Hart::iXORI(int output, int input1, int32_t immediate) {
+  int32_t result = breg[input1] ^ immediate;
+  breg[output] = result;
+  return result;
+}
+
+/**
+ * Função SLL do tipo R. Shifta o primeiro registrador para a esquerda pelos 5
+ * bits de baixo do segundo.
+ * @param output Endereço de registrador que recebe o resultado.
+ * @param input1 Registrador com o número a ser shiftado.
+ * @param input2 Registrador com a quantidade de bits.
+ * @result O número shiftado.
+ */
+int32_t Hart::rSLL(int output, int input1, int input2) {
+  int32_t result = (uint32_t)breg[input1] << (breg[input2] & 0x1F);
+  breg[output] = result;
+  return result;
+}
+
+/**
+ * Função SRL do tipo R. Shift lógico para a direita pelos 5 bits de baixo do
+ * segundo registrador.
+ * @param output Endereço de registrador que recebe o resultado.
+ * @param input1 Registrador com o número a ser shiftado.
+ * @param input2 Registrador com a quantidade de bits.
+ * @result O número shiftado.
+ */
+int32_t Hart::rSRL(int output, int input1, int input2) {
+  int32_t result = (uint32_t)breg[input1] >> (breg[input2] & 0x1F);
+  breg[output] = result;
+  return result;
+}
+
+/**
+ * Função SRA do tipo R. Shift aritmético para a direita pelos 5 bits de baixo
+ * do segundo registrador.
+ * @param output Endereço de registrador que recebe o resultado.
+ * @param input1 Registrador com o número a ser shiftado.
+ * @param input2 Registrador com a quantidade de bits.
+ * @result O número shiftado.
+ */
+int32_t Hart::rSRA(int output, int input1, int input2) {
+  int32_t result = breg[input1] >> (breg[input2] & 0x1F);
+  breg[output] = result;
+  return result;
+}
+
+/**
+ * Função FENCE (e FENCE.I). As escritas no código já invalidam as caches de
+ * instruções do hart; com vários harts (smp.cpp) a barreira do host garante
+ * que os loads seguintes não passam na frente dos stores anteriores.
+ */
+void Hart::iFENCE() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+
+// Operações da extensão M, usadas também pelos motores threaded e JIT. No
+// RISC-V a divisão por zero e o overflow de INT32_MIN / -1 não geram exceção:
+// o resultado é fixado pela especificação.
+
+int32_t rv_mulh(int32_t a, int32_t b) { return ((int64_t)a * b) >> 32; }
+
+int32_t rv_mulhsu(int32_t a, int32_t b) {
+  return ((int64_t)a * (uint32_t)b) >> 32;
+}
+
+int32_t rv_mulhu(int32_t a, int32_t b) {
+  return ((uint64_t)(uint32_t)a * (uint32_t)b) >> 32;
+}
+
+int32_t rv_div(int32_t a, int32_t b) {
+  if (b == 0) {
+    return -1;
+  }
+  if (a == INT32_MIN && b == -1) {
+    return a;
+  }
+  return a / b;
+}
+
+int32_t rv_divu(int32_t a, int32_t b) {
+  return b == 0 ? -1 : (int32_t)((uint32_t)a / (uint32_t)b);
+}
+
+int32_t rv_rem(int32_t a, int32_t b) {
+  if (b == 0) {
+    return a;
+  }
+  if (a == INT32_MIN && b == -1) {
+    return 0;
+  }
+  return a % b;
+}
+
+int32_t rv_remu(int32_t a, int32_t b) {
+  return b == 0 ? a : (int32_t)((uint32_t)a % (uint32_t)b);
+}
+
+/**
+ * Função MUL do tipo R. Multiplica os registradores e guarda os 32 bits de
+ * baixo do produto.
+ * @param output Endereço de registrador que recebe o resultado.
+ * @param input1 Primeiro registrador a ser multiplicado.
+ * @param input2 Segundo registrador a ser multiplicado.
+ * @return O produto.
+ */
+int32_t Hart::rMUL(int output, int input1, int input2) {
+  int32_t result = (uint32_t)breg[input1] * (uint32_t)breg[input2];
+  breg[output] = result;
+  return result;
+}
+
+/**
+ * Função MULH do tipo R. Guarda os 32 bits de cima do produto com sinal.
+ * @param output Endereço de registrador que recebe o resultado.
+ * @param input1 Primeiro registrador a ser multiplicado.
+ * @param input2 Segundo registrador a ser multiplicado.
+ * @return A parte alta do produto.
  */
-bool sysECALL() {
-  int value = breg[A7];
-  switch (value) {
-    case 1:
-      printf("%d", breg[A0]);
+int32_t Hart::rMULH(int output, int input1, int input2) {
+  int32_t result = rv_mulh(breg[input1], breg[input2]);
+  breg[output] = result;
+  return result;
+}
+
+/**
+ * Função MULHSU do tipo R. Parte alta do produto do primeiro registrador (com
+ * sinal) pelo segundo (sem sinal).
+ * @param output Endereço de registrador que recebe o resultado.
+ * @param input1 Primeiro registrador a ser multiplicado.
+ * @param input2 Segundo registrador a ser multiplicado (unsigned).
+ * @return A parte alta do produto.
+ */
+int32_t Hart::rMULHSU(int output, int input1, int input2) {
+  int32_t result = rv_mulhsu(breg[input1], breg[input2]);
+  breg[output] = result;
+  return result;
+}
+
+/**
+ * Função MULHU do tipo R. Parte alta do produto sem sinal.
+ * @param output Endereço de registrador que recebe o resultado.
+ * @param input1 Primeiro registrador a ser multiplicado (unsigned).
+ * @param input2 Segundo registrador a ser multiplicado (unsigned).
+ * @return A parte alta do produto.
+ */
+int32_t Hart::rMULHU(int output, int input1, int input2) {
+  int32_t result = rv_mulhu(breg[input1], breg[input2]);
+  breg[output] = result;
+  return result;
+}
+
+/**
+ * Função DIV do tipo R. Divide o primeiro registrador pelo segundo, com sinal,
+ * arredondando para zero.
+ * @param output Endereço de registrador que recebe o resultado.
+ * @param input1 Registrador com o dividendo.
+ * @param input2 Registrador com o divisor.
+ * @return O quociente.
+ */
+int32_t Hart::rDIV(int output, int input1, int input2) {
+  int32_t result = rv_div(breg[input1], breg[input2]);
+  breg[output] = result;
+  return result;
+}
+
+/**
+ * Função DIVU do tipo R. Divide o primeiro registrador pelo segundo, sem
+ * sinal.
+ * @param output Endereço de registrador que recebe o resultado.
+ * @param input1 Registrador com o dividendo (unsigned).
+ * @param input2 Registrador com o divisor (unsigned).
+ * @return O quociente.
+ */
+int32_t Hart::rDIVU(int output, int input1, int input2) {
+  int32_t result = rv_divu(breg[input1], breg[input2]);
+  breg[output] = result;
+  return result;
+}
+
+/**
+ * Função REM do tipo R. Resto da divisão com sinal, com o sinal do dividendo.
+ * @param output Endereço de registrador que recebe o resultado.
+ * @param input1 Registrador com o dividendo.
+ * @param input2 Registrador com o divisor.
+ * @return O resto.
+ */
+int32_t Hart::rREM(int output, int input1, int input2) {
+  int32_t result = rv_rem(breg[input1], breg[input2]);
+  breg[output] = result;
+  return result;
+}
+
+/**
+ * Função REMU do tipo R. Resto da divisão sem sinal.
+ * @param output Endereço de registrador que recebe o resultado.
+ * @param input1 Registrador com o dividendo (unsigned).
+ * @param input2 Registrador com o divisor (unsigned).
+ * @return O resto.
+ */
+int32_t Hart::rREMU(int output, int input1, int input2) {
+  int32_t result = rv_remu(breg[input1], breg[input2]);
+  breg[output] = result;
+  return result;
+}
+
+// Operações da extensão A. A palavra é acessada com as operações atômicas do
+// host, então harts que dividem a memória (smp.cpp) em threads diferentes
+// veem cada instrução atômica inteira.
+
+/**
+ * Valor que uma instrução AMO escreve na memória.
+ * @param operation A instrução (I_amoswap_w, I_amoadd_w, ...).
+ * @param old Valor que estava na memória.
+ * @param value Valor de rs2.
+ * @return O novo valor da palavra.
+ */
+int32_t rv_amo(INSTRUCTIONS operation, int32_t old, int32_t value) {
+  switch (operation) {
+    case I_amoswap_w:
+      return value;
+    case I_amoadd_w:
+      return (uint32_t)old + (uint32_t)value;
+    case I_amoxor_w:
+      return old ^ value;
+    case I_amoand_w:
+      return old & value;
+    case I_amoor_w:
+      return old | value;
+    case I_amomin_w:
+      return min(old, value);
+    case I_amomax_w:
+      return max(old, value);
+    case I_amominu_w:
+      return min((uint32_t)old, (uint32_t)value);
+    default:  // I_amomaxu_w
+      return max((uint32_t)old, (uint32_t)value);
+  }
+}
+
+/**
+ * Função LR.W do tipo R. Carrega a palavra do endereço e guarda a reserva
+ * (endereço e valor lido) para o SC.W.
+ * @param output Endereço de registrador que recebe a palavra.
+ * @param address Registrador com o endereço da palavra.
+ * @return A palavra lida.
+ */
+int32_t Hart::rLRW(int output, int address) {
+  uint32_t at = breg[address];
+  int32_t *word = mem_atomic_word(&mem, at);
+  if (word == NULL) {
+    return 0;
+  }
+  int32_t value = __atomic_load_n(word, __ATOMIC_SEQ_CST);
+  reserved = true;
+  reserved_address = at;
+  reserved_value = value;
+  breg[output] = value;
+  return value;
+}
+
+/**
+ * Função SC.W do tipo R. Escreve rs2 no endereço se a reserva do LR.W ainda
+ * vale e desfaz a reserva. A reserva é conferida com uma troca atômica
+ * (compare-and-swap) contra o valor lido pelo LR.W: o SC.W falha se a palavra
+ * mudou, mas não percebe outro hart que escreveu nela o mesmo valor.
+ * @param output Endereço de registrador que recebe 0 se escreveu, 1 se não.
+ * @param address Registrador com o endereço da palavra.
+ * @param input Registrador com o valor a ser escrito.
+ * @return O valor posto em rd.
+ */
+int32_t Hart::rSCW(int output, int address, int input) {
+  uint32_t at = breg[address];
+  int32_t value = breg[input];
+  bool valid = reserved && reserved_address == at;
+  reserved = false;
+  int32_t *word = mem_atomic_word(&mem, at);
+  if (word == NULL) {
+    return 0;
+  }
+  int32_t expected = reserved_value;
+  int32_t result = 1;
+  if (valid && __atomic_compare_exchange_n(word, &expected, value, false,
+                                           __ATOMIC_SEQ_CST,
+                                           __ATOMIC_SEQ_CST)) {
+    result = 0;
+    invalidate_decoded(at);
+    log_store(at, 4, value);
+  }
+  breg[output] = result;
+  return result;
+}
+
+/**
+ * Funções AMO*.W do tipo R. Numa só operação atômica, lê a palavra do
+ * endereço, escreve nela o resultado da operação com rs2 e põe o valor antigo
+ * em rd.
+ * @param operation A instrução (I_amoswap_w, I_amoadd_w, ...).
+ * @param output Endereço de registrador que recebe o valor antigo.
+ * @param address Registrador com o endereço da palavra.
+ * @param input Registrador com o outro operando.
+ * @return O valor antigo.
+ */
+int32_t Hart::rAMOW(INSTRUCTIONS operation, int output, int address,
+                    int input) {
+  uint32_t at = breg[address];
+  int32_t value = breg[input];
+  int32_t *word = mem_atomic_word(&mem, at);
+  if (word == NULL) {
+    return 0;
+  }
+  int32_t old;
+  switch (operation) {
+    case I_amoswap_w:
+      old = __atomic_exchange_n(word, value, __ATOMIC_SEQ_CST);
+      break;
+    case I_amoadd_w:
+      old = __atomic_fetch_add(word, value, __ATOMIC_SEQ_CST);
       break;
-    case 4:
-      printf("%d", mem[breg[A0] >> 2]);
+    case I_amoxor_w:
+      old = __atomic_fetch_xor(word, value, __ATOMIC_SEQ_CST);
       break;
-    case 10:
-      return true;
-    default:
+    case I_amoand_w:
+      old = __atomic_fetch_and(word, value, __ATOMIC_SEQ_CST);
+      break;
+    case I_amoor_w:
+      old = __atomic_fetch_or(word, value, __ATOMIC_SEQ_CST);
+      break;
+    default:  // min e max: tenta de novo se a palavra mudou no meio
+      old = __atomic_load_n(word, __ATOMIC_SEQ_CST);
+      while (!__atomic_compare_exchange_n(word, &old,
+                                          rv_amo(operation, old, value), true,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+      }
       break;
   }
-  return false;
+  breg[output] = old;
+  invalidate_decoded(at);
+  log_store(at, 4, rv_amo(operation, old, value));
+  return old;
+}
+
+// Definidos em syscalls.cpp e smp.cpp
+bool dispatch_syscall(Hart &h);
+bool smp_syscall(Hart &h);
+
+/**
+ * Função ecall. Executa o serviço de A7 pela tabela de syscalls.cpp; com
+ * vários harts na mesma memória, um ecall de cada vez (ver smp.cpp).
+ * @return Se a função chamar exit retorna true.
+ */
+bool Hart::sysECALL() {
+  return smp == nullptr ? dispatch_syscall(*this) : smp_syscall(*this);
 }
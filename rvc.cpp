@@ -0,0 +1,243 @@
+/*
+ *  rvc.cpp
+ *
+ * Extensao C (instrucoes comprimidas de 16 bits) do RV32IC. Cada instrucao
+ * comprimida e expandida para a instrucao de 32 bits equivalente, que passa
+ * pelo decode normal. A expansao so acontece no fetch, e o resultado fica na
+ * cache de instrucoes decodificadas (uma entrada por meia palavra), entao o
+ * caminho quente nunca expande de novo.
+ *
+ * As instrucoes de ponto flutuante (c.flw, c.fsd etc.), as do RV64 e o
+ * c.ebreak nao existem aqui: viram instrucao invalida, assim como os encodings
+ * reservados.
+ */
+
+enum { RVC_ILLEGAL = 0 };  // palavra invalida para o decode
+
+// Campo [hi:lo] da instrucao comprimida
+//
+uint32_t rvc_bits(uint32_t c, int hi, int lo) {
+  return (c >> lo) & ((1u << (hi - lo + 1)) - 1);
+}
+
+// Registrador dos campos de 3 bits (x8 a x15)
+//
+uint32_t rvc_reg(uint32_t c, int lo) { return 8 + rvc_bits(c, lo + 2, lo); }
+
+// Estende o sinal de um valor de bits bits
+//
+int32_t rvc_sext(uint32_t value, int bits) {
+  return (int32_t)(value << (32 - bits)) >> (32 - bits);
+}
+
+/******************************** CODIFICACAO ********************************/
+
+uint32_t rvc_r(uint32_t opcode, uint32_t f3, uint32_t f7, uint32_t rd,
+               uint32_t rs1, uint32_t rs2) {
+  return (f7 << 25) | (rs2 << 20) | (rs1 << 15) | (f3 << 12) | (rd << 7) |
+         opcode;
+}
+
+uint32_t rvc_i(uint32_t opcode, uint32_t f3, uint32_t rd, uint32_t rs1,
+               int32_t imm) {
+  return ((uint32_t)imm << 20) | (rs1 << 15) | (f3 << 12) | (rd << 7) |
+         opcode;
+}
+
+uint32_t rvc_s(uint32_t opcode, uint32_t f3, uint32_t rs1, uint32_t rs2,
+               int32_t imm) {
+  return (((uint32_t)imm >> 5 & 0x7F) << 25) | (rs2 << 20) | (rs1 << 15) |
+         (f3 << 12) | (((uint32_t)imm & 0x1F) << 7) | opcode;
+}
+
+uint32_t rvc_b(uint32_t f3, uint32_t rs1, uint32_t rs2, int32_t imm) {
+  uint32_t u = imm;
+  return ((u >> 12 & 1) << 31) | ((u >> 5 & 0x3F) << 25) | (rs2 << 20) |
+         (rs1 << 15) | (f3 << 12) | ((u >> 1 & 0xF) << 8) |
+         ((u >> 11 & 1) << 7) | BType;
+}
+
+uint32_t rvc_j(uint32_t rd, int32_t imm) {
+  uint32_t u = imm;
+  return ((u >> 20 & 1) << 31) | ((u >> 1 & 0x3FF) << 21) |
+         ((u >> 11 & 1) << 20) | ((u >> 12 & 0xFF) << 12) | (rd << 7) | JAL;
+}
+
+/********************************* EXPANSAO **********************************/
+
+// Offset dos c.j/c.jal: imm[11|4|9:8|10|6|7|3:1|5] nos bits 12:2
+//
+int32_t rvc_jump_offset(uint32_t c) {
+  uint32_t imm = rvc_bits(c, 12, 12) << 11 | rvc_bits(c, 11, 11) << 4 |
+                 rvc_bits(c, 10, 9) << 8 | rvc_bits(c, 8, 8) << 10 |
+                 rvc_bits(c, 7, 7) << 6 | rvc_bits(c, 6, 6) << 7 |
+                 rvc_bits(c, 5, 3) << 1 | rvc_bits(c, 2, 2) << 5;
+  return rvc_sext(imm, 12);
+}
+
+// Offset dos c.beqz/c.bnez: imm[8|4:3] nos bits 12:10, imm[7:6|2:1|5] nos
+// bits 6:2
+//
+int32_t rvc_branch_offset(uint32_t c) {
+  uint32_t imm = rvc_bits(c, 12, 12) << 8 | rvc_bits(c, 11, 10) << 3 |
+                 rvc_bits(c, 6, 5) << 6 | rvc_bits(c, 4, 3) << 1 |
+                 rvc_bits(c, 2, 2) << 5;
+  return rvc_sext(imm, 9);
+}
+
+// Imediato de 6 bits com sinal: imm[5] no bit 12, imm[4:0] nos bits 6:2
+//
+int32_t rvc_imm6(uint32_t c) {
+  return rvc_sext(rvc_bits(c, 12, 12) << 5 | rvc_bits(c, 6, 2), 6);
+}
+
+// Quadrante 0: acessos a memoria pelos registradores x8-x15
+//
+uint32_t rvc_quadrant0(uint32_t c) {
+  uint32_t rd = rvc_reg(c, 2);
+  uint32_t rs1 = rvc_reg(c, 7);
+  // c.lw/c.sw: uimm[5:3] nos bits 12:10, uimm[2] no 6, uimm[6] no 5
+  int32_t offset = rvc_bits(c, 12, 10) << 3 | rvc_bits(c, 6, 6) << 2 |
+                   rvc_bits(c, 5, 5) << 6;
+  switch (rvc_bits(c, 15, 13)) {
+    case 0: {  // c.addi4spn: nzuimm[5:4|9:6|2|3] nos bits 12:5
+      int32_t imm = rvc_bits(c, 12, 11) << 4 | rvc_bits(c, 10, 7) << 6 |
+                    rvc_bits(c, 6, 6) << 2 | rvc_bits(c, 5, 5) << 3;
+      if (imm == 0) {
+        return RVC_ILLEGAL;
+      }
+      return rvc_i(ILAType, ADDI3, rd, SP, imm);
+    }
+    case 2:  // c.lw
+      return rvc_i(ILType, LW3, rd, rs1, offset);
+    case 6:  // c.sw
+      return rvc_s(StoreType, SW3, rs1, rd, offset);
+    default:
+      return RVC_ILLEGAL;
+  }
+}
+
+// Quadrante 1: imediatos, aritmetica com x8-x15 e desvios
+//
+uint32_t rvc_quadrant1(uint32_t c) {
+  uint32_t rd = rvc_bits(c, 11, 7);
+  uint32_t rd3 = rvc_reg(c, 7);
+  uint32_t rs2 = rvc_reg(c, 2);
+  switch (rvc_bits(c, 15, 13)) {
+    case 0:  // c.addi (c.nop com rd = 0)
+      return rvc_i(ILAType, ADDI3, rd, rd, rvc_imm6(c));
+    case 1:  // c.jal
+      return rvc_j(RA, rvc_jump_offset(c));
+    case 2:  // c.li
+      return rvc_i(ILAType, ADDI3, rd, ZERO, rvc_imm6(c));
+    case 3:
+      if (rd == SP) {  // c.addi16sp: nzimm[9] no bit 12, [4|6|8:7|5] 6:2
+        uint32_t imm = rvc_bits(c, 12, 12) << 9 | rvc_bits(c, 6, 6) << 4 |
+                       rvc_bits(c, 5, 5) << 6 | rvc_bits(c, 4, 3) << 7 |
+                       rvc_bits(c, 2, 2) << 5;
+        if (imm == 0) {
+          return RVC_ILLEGAL;
+        }
+        return rvc_i(ILAType, ADDI3, SP, SP, rvc_sext(imm, 10));
+      }
+      if (rvc_imm6(c) == 0) {  // c.lui: nzimm[17:12]
+        return RVC_ILLEGAL;
+      }
+      return ((uint32_t)rvc_imm6(c) << 12) | (rd << 7) | LUI;
+    case 4:
+      switch (rvc_bits(c, 11, 10)) {
+        case 0:  // c.srli
+          if (rvc_bits(c, 12, 12)) {
+            return RVC_ILLEGAL;  // shamt[5] so existe no RV64
+          }
+          return rvc_i(ILAType, SRI3, rd3, rd3, rvc_bits(c, 6, 2));
+        case 1:  // c.srai
+          if (rvc_bits(c, 12, 12)) {
+            return RVC_ILLEGAL;
+          }
+          return rvc_i(ILAType, SRI3, rd3, rd3,
+                       SRAI7 << 5 | rvc_bits(c, 6, 2));
+        case 2:  // c.andi
+          return rvc_i(ILAType, ANDI3, rd3, rd3, rvc_imm6(c));
+        default:
+          if (rvc_bits(c, 12, 12)) {
+            return RVC_ILLEGAL;  // c.subw/c.addw do RV64
+          }
+          switch (rvc_bits(c, 6, 5)) {
+            case 0:  // c.sub
+              return rvc_r(RegType, ADDSUB3, SUB7, rd3, rd3, rs2);
+            case 1:  // c.xor
+              return rvc_r(RegType, XOR3, 0, rd3, rd3, rs2);
+            case 2:  // c.or
+              return rvc_r(RegType, OR3, 0, rd3, rd3, rs2);
+            default:  // c.and
+              return rvc_r(RegType, AND3, 0, rd3, rd3, rs2);
+          }
+      }
+    case 5:  // c.j
+      return rvc_j(ZERO, rvc_jump_offset(c));
+    case 6:  // c.beqz
+      return rvc_b(BEQ3, rd3, ZERO, rvc_branch_offset(c));
+    default:  // c.bnez
+      return rvc_b(BNE3, rd3, ZERO, rvc_branch_offset(c));
+  }
+}
+
+// Quadrante 2: acessos pela pilha, mv/add e saltos por registrador
+//
+uint32_t rvc_quadrant2(uint32_t c) {
+  uint32_t rd = rvc_bits(c, 11, 7);
+  uint32_t rs2 = rvc_bits(c, 6, 2);
+  switch (rvc_bits(c, 15, 13)) {
+    case 0:  // c.slli
+      if (rvc_bits(c, 12, 12)) {
+        return RVC_ILLEGAL;
+      }
+      return rvc_i(ILAType, SLLI3, rd, rd, rs2);
+    case 2: {  // c.lwsp: uimm[5] no bit 12, uimm[4:2|7:6] nos bits 6:2
+      if (rd == ZERO) {
+        return RVC_ILLEGAL;
+      }
+      int32_t offset = rvc_bits(c, 12, 12) << 5 | rvc_bits(c, 6, 4) << 2 |
+                       rvc_bits(c, 3, 2) << 6;
+      return rvc_i(ILType, LW3, rd, SP, offset);
+    }
+    case 4:
+      if (!rvc_bits(c, 12, 12)) {
+        if (rs2 == ZERO) {  // c.jr
+          if (rd == ZERO) {
+            return RVC_ILLEGAL;
+          }
+          return rvc_i(JALR, 0, ZERO, rd, 0);
+        }
+        return rvc_r(RegType, ADDSUB3, ADD7, rd, ZERO, rs2);  // c.mv
+      }
+      if (rs2 == ZERO) {
+        if (rd == ZERO) {
+          return RVC_ILLEGAL;  // c.ebreak: o nucleo nao tem ebreak
+        }
+        return rvc_i(JALR, 0, RA, rd, 0);  // c.jalr
+      }
+      return rvc_r(RegType, ADDSUB3, ADD7, rd, rd, rs2);  // c.add
+    case 6: {  // c.swsp: uimm[5:2|7:6] nos bits 12:7
+      int32_t offset = rvc_bits(c, 12, 9) << 2 | rvc_bits(c, 8, 7) << 6;
+      return rvc_s(StoreType, SW3, SP, rs2, offset);
+    }
+    default:
+      return RVC_ILLEGAL;
+  }
+}
+
+// Expande a instrucao comprimida c (bits 1:0 diferentes de 11). Devolve
+// RVC_ILLEGAL para os encodings invalidos, que o decode rejeita.
+//
+uint32_t rvc_expand(uint32_t c) {
+  switch (c & 3) {
+    case 0:
+      return rvc_quadrant0(c);
+    case 1:
+      return rvc_quadrant1(c);
+    default:
+      return rvc_quadrant2(c);
+  }
+}
@@ -0,0 +1,139 @@
+/*
+ *  smp.cpp
+ *
+ * Varios harts rodando o mesmo programa sobre a mesma memoria, cada um na
+ * sua thread do host (main.exe -H n). Todos comecam no ponto de entrada com
+ * o numero do hart em a0 e o numero de harts em a1; o hart i comeca com
+ * sp = sp inicial - i * SMP_STACK_BYTES, numa pilha propria ja mapeada.
+ *
+ * Os outros harts usam a tabela de paginas do hart 0 (mem_share). Antes de
+ * comecar todas as paginas viram proprias e as novas passam a ser alocadas
+ * no mem_map(), entao uma entrada da tabela nunca muda depois de preenchida e
+ * cada hart usa a sua TLB sem trava. Loads e stores sao acessos comuns a
+ * memoria do host do tamanho do acesso (no x86 a ordem deles ja e mais forte
+ * que a do RISC-V). LR/SC, AMO e FENCE usam as operacoes atomicas do host
+ * (ver riscvcommands.cpp).
+ *
+ * Os harts so se sincronizam nas atomicas e nas fronteiras de quantum: cada
+ * um roda SMP_QUANTUM instrucoes no laco do seu motor (resume_engine) e so
+ * entao olha se o programa terminou. Os ecalls rodam um de cada vez, sob a
+ * trava do grupo, com o heap (brk) e os arquivos abertos do grupo; a saida de
+ * cada ecall e escrita na hora.
+ *
+ * Um hart termina sozinho (exit, falta, fim do texto, limite do -l); o
+ * programa termina quando o hart 0 termina, e os outros param no fim do
+ * quantum em que estao. Cada hart tem a sua cache de instrucoes (e o seu
+ * JIT): codigo escrito por um hart nao invalida a cache dos outros.
+ */
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+enum { SMP_QUANTUM = 10000 };  // instrucoes entre as olhadas no fim
+enum : uint32_t { SMP_STACK_BYTES = 1 << 20 };  // pilha de cada hart
+enum { SMP_MAX_HARTS = 64 };
+
+// Estado dividido pelos harts de um programa
+//
+struct Smp {
+  mutex lock;  // um ecall de cada vez
+  uint32_t brk;
+  vector<OpenFile> files;
+  atomic<bool> done;  // o hart 0 terminou
+};
+
+// Ecall de um hart do grupo: roda com o heap e os arquivos do grupo
+//
+bool smp_syscall(Hart &h) {
+  Smp &s = *h.smp;
+  lock_guard<mutex> lock(s.lock);
+  h.brk = s.brk;
+  h.files.swap(s.files);
+  bool stop = dispatch_syscall(h);
+  s.brk = h.brk;
+  h.files.swap(s.files);
+  h.console.flush();
+  return stop;
+}
+
+// Laco da thread do hart id
+//
+void smp_run_hart(Smp &s, Hart &h, ENGINES engine, uint32_t id,
+                  uint32_t count) {
+  engine = h.start_engine(engine);
+  h.breg[A0] = id;
+  h.breg[A1] = count;
+  uint64_t limit = h.instret_limit;
+  while (!s.done.load(memory_order_relaxed)) {
+    h.instret_limit = min(limit, h.instret + SMP_QUANTUM);
+    h.resume_engine(engine);
+    h.instret_limit = limit;
+    if (!h.running()) {
+      break;
+    }
+  }
+  if (id == 0) {
+    s.done = true;
+  }
+}
+
+// Roda o programa ja carregado em h com count harts. Devolve -1 se nao foi
+// possivel preparar a memoria.
+//
+int run_smp(Hart &h, unsigned count, ENGINES engine) {
+  if (count > SMP_MAX_HARTS) {
+    printf("No maximo %d harts\n", SMP_MAX_HARTS);
+    return -1;
+  }
+  if (!mem_make_private(&h.mem)) {
+    printf("Memoria insuficiente para os harts\n");
+    return -1;
+  }
+  Smp s;
+  s.brk = h.brk;
+  s.files.swap(h.files);
+  s.done = false;
+  h.smp = &s;
+  vector<unique_ptr<Hart>> others;
+  vector<Hart *> harts = {&h};
+  for (unsigned i = 1; i < count; i++) {
+    Hart *o = new Hart();
+    others.emplace_back(o);
+    harts.push_back(o);
+    mem_share(&o->mem, &h.mem);
+    o->entry = h.entry;
+    o->gp = h.gp;
+    o->sp = h.sp - i * SMP_STACK_BYTES;
+    mem_map(&o->mem, o->sp + 4 - SMP_STACK_BYTES, SMP_STACK_BYTES);
+    o->set_text(h.text_start, h.text_size);
+    o->instret_limit = h.instret_limit;
+    o->smp = &s;
+  }
+
+  vector<thread> threads;
+  for (unsigned i = 1; i < count; i++) {
+    threads.emplace_back(smp_run_hart, ref(s), ref(*harts[i]), engine, i,
+                         count);
+  }
+  smp_run_hart(s, h, engine, 0, count);
+  for (thread &t : threads) {
+    t.join();
+  }
+
+  // os harts que pararam junto com o hart 0 nao tem o que relatar
+  for (unsigned i = 0; i < count; i++) {
+    if (i == 0 || !harts[i]->running()) {
+      harts[i]->report_finish();
+    }
+  }
+  for (unsigned i = 0; i < count; i++) {
+    printf("hart %2u: %12llu instrucoes\n", i,
+           (unsigned long long)harts[i]->instret);
+  }
+  others.clear();
+  h.smp = nullptr;
+  h.brk = s.brk;
+  h.files.swap(s.files);
+  return 0;
+}
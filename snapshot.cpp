@@ -0,0 +1,317 @@
+/*
+ *  snapshot.cpp
+ *
+ * Snapshot do estado completo de um hart: registradores, PC, memoria,
+ * segmento de texto, heap (brk) e arquivos abertos. Serve
+ * para pular a parte comum de muitas execucoes (inicializacao do runtime,
+ * montagem de tabelas): o programa roda uma vez ate o ecall de snapshot (ver
+ * sys_snapshot) ou ate o limite do -l, o estado vai para um arquivo, e cada
+ * execucao seguinte comeca direto dele. O hart restaurado trata o estado do
+ * snapshot como o seu estado inicial (entry, sp e gp), entao os motores, que
+ * sempre comecam pelo init(), partem dele; o contador de instrucoes recomeca
+ * do zero.
+ *
+ * O arquivo e compacto: so as paginas com conteudo sao gravadas; as mapeadas
+ * que estao zeradas viram intervalos (SnapshotRun). Carregado, o snapshot
+ * guarda as paginas num bloco so, e restaurar um hart nao copia nada: as
+ * paginas dele apontam para o bloco e so sao copiadas na primeira escrita
+ * (ver mem_map_shared), entao N harts restaurados do mesmo snapshot dividem
+ * a memoria ate divergirem.
+ *
+ * O console e esvaziado antes do snapshot, entao a saida da parte comum nao
+ * se repete nas execucoes restauradas. A entrada do console nao e gravada.
+ * Os arquivos abertos sao reabertos pelo nome, na mesma posicao; os abertos
+ * para escrita nao sao truncados de novo.
+ */
+
+enum : uint32_t { SNAPSHOT_VERSION = 1 };
+enum { SNAPSHOT_MAX_FD = 4096 };  // descritor maximo aceito na leitura
+
+const char SNAPSHOT_MAGIC[8] = {'R', 'V', '3', '2', 'S', 'N', 'A', 'P'};
+
+// Cabecalho do arquivo. Depois dele vem zero_runs SnapshotRun, data_pages
+// enderecos de pagina, o conteudo dessas paginas e file_count arquivos, cada
+// um uma SnapshotFile seguida do nome.
+//
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t pc, text_start, text_size, brk;
+  uint32_t zero_runs, data_pages, file_count;
+  int32_t breg[32];
+};
+
+// Paginas consecutivas mapeadas e zeradas
+//
+struct SnapshotRun {
+  uint32_t address, pages;
+};
+
+// Arquivo aberto pelo programa
+//
+struct SnapshotFile {
+  int32_t fd;
+  uint32_t name_size;
+  int64_t position;
+  char mode[4];
+};
+
+static_assert(sizeof(SnapshotHeader) == 168, "cabecalho do snapshot");
+static_assert(sizeof(SnapshotRun) == 8, "intervalo do snapshot");
+static_assert(sizeof(SnapshotFile) == 24, "arquivo do snapshot");
+
+struct Snapshot {
+  SnapshotHeader header;
+  vector<SnapshotRun> zero_runs;
+  vector<uint32_t> page_addresses;
+  vector<int32_t> contents;  // paginas com conteudo, uma depois da outra
+  vector<SnapshotFile> files;
+  vector<string> file_names;
+};
+
+// Acrescenta uma pagina mapeada ao snapshot (ver mem_for_each_page)
+//
+void snapshot_page(void *ctx, uint32_t address, const int32_t *page) {
+  Snapshot *s = static_cast<Snapshot *>(ctx);
+  if (page != mem_zero_page && memcmp(page, mem_zero_page, PAGE_BYTES) != 0) {
+    s->page_addresses.push_back(address);
+    s->contents.insert(s->contents.end(), page, page + PAGE_WORDS);
+    return;
+  }
+  if (!s->zero_runs.empty() &&
+      s->zero_runs.back().address + s->zero_runs.back().pages * PAGE_BYTES ==
+          address) {
+    s->zero_runs.back().pages++;
+  } else {
+    s->zero_runs.push_back(SnapshotRun{address, 1});
+  }
+}
+
+// Tira o snapshot do hart, que volta a executar em pc
+//
+shared_ptr<Snapshot> take_snapshot(Hart &h, uint32_t pc) {
+  shared_ptr<Snapshot> s = make_shared<Snapshot>();
+  SnapshotHeader &header = s->header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.pc = pc;
+  header.text_start = h.text_start;
+  header.text_size = h.text_size;
+  header.brk = h.brk;
+  memcpy(header.breg, h.breg, sizeof(header.breg));
+
+  h.console.flush();
+  mem_for_each_page(&h.mem, snapshot_page, s.get());
+
+  for (size_t fd = 3; fd < h.files.size(); fd++) {
+    const OpenFile &file = h.files[fd];
+    if (file.fptr == nullptr) {
+      continue;
+    }
+    fflush(file.fptr);
+    SnapshotFile saved;
+    memset(&saved, 0, sizeof(saved));
+    saved.fd = fd;
+    saved.name_size = file.name.size();
+    saved.position = ftell(file.fptr);
+    snprintf(saved.mode, sizeof(saved.mode), "%s", file.mode.c_str());
+    s->files.push_back(saved);
+    s->file_names.push_back(file.name);
+  }
+  header.zero_runs = s->zero_runs.size();
+  header.data_pages = s->page_addresses.size();
+  header.file_count = s->files.size();
+  return s;
+}
+
+// Grava o snapshot no arquivo fn. Devolve false se nao conseguir escrever.
+//
+bool write_snapshot(const Snapshot &s, const char *fn) {
+  FILE *fptr = fopen(fn, "wb");
+  if (fptr == nullptr) {
+    return false;
+  }
+  bool ok =
+      fwrite(&s.header, sizeof(s.header), 1, fptr) == 1 &&
+      fwrite(s.zero_runs.data(), sizeof(SnapshotRun), s.zero_runs.size(),
+             fptr) == s.zero_runs.size() &&
+      fwrite(s.page_addresses.data(), sizeof(uint32_t),
+             s.page_addresses.size(), fptr) == s.page_addresses.size() &&
+      fwrite(s.contents.data(), sizeof(int32_t), s.contents.size(), fptr) ==
+          s.contents.size();
+  for (size_t i = 0; ok && i < s.files.size(); i++) {
+    ok = fwrite(&s.files[i], sizeof(SnapshotFile), 1, fptr) == 1 &&
+         fwrite(s.file_names[i].data(), 1, s.file_names[i].size(), fptr) ==
+             s.file_names[i].size();
+  }
+  return fclose(fptr) == 0 && ok;
+}
+
+// Tira o snapshot do hart, que volta a executar em pc, e grava no arquivo fn
+//
+bool save_snapshot(Hart &h, const char *fn, uint32_t pc) {
+  return write_snapshot(*take_snapshot(h, pc), fn);
+}
+
+// Bytes do arquivo que ainda nao foram lidos
+//
+uint64_t snapshot_remaining(FILE *fptr, uint64_t size) {
+  long at = ftell(fptr);
+  return at < 0 || (uint64_t)at > size ? 0 : size - at;
+}
+
+// Le count elementos do arquivo, que tem size bytes, para out. As contagens
+// vem do arquivo: so aloca o que cabe no resto dele.
+//
+template <typename T>
+bool snapshot_read(FILE *fptr, uint64_t size, vector<T> &out, size_t count) {
+  if (count > snapshot_remaining(fptr, size) / sizeof(T)) {
+    return false;
+  }
+  out.resize(count);
+  return count == 0 || fread(out.data(), sizeof(T), count, fptr) == count;
+}
+
+// Confere a memoria e o segmento de texto de um snapshot lido do arquivo:
+// paginas alinhadas, dentro dos 32 bits, em ordem e sem repetir (como o
+// take_snapshot grava), e o segmento de texto todo em paginas mapeadas.
+//
+bool snapshot_valid(const Snapshot &s) {
+  const SnapshotHeader &header = s.header;
+  uint64_t text_begin = header.text_start & ~(uint64_t)(PAGE_BYTES - 1);
+  uint64_t text_end = (uint64_t)header.text_start + header.text_size;
+  if (text_end > (1ull << 32)) {
+    return false;
+  }
+  uint64_t text_pages = 0;  // paginas do texto cobertas pelo snapshot
+  uint64_t end = 0;         // fim do intervalo anterior
+  for (const SnapshotRun &run : s.zero_runs) {
+    uint64_t run_end = run.address + (uint64_t)run.pages * PAGE_BYTES;
+    if (run.address % PAGE_BYTES != 0 || run.pages == 0 ||
+        run_end > (1ull << 32) || run.address < end) {
+      return false;
+    }
+    end = run_end;
+    uint64_t from = max<uint64_t>(run.address, text_begin);
+    uint64_t to = min<uint64_t>(run_end, text_end);
+    text_pages += from < to ? (to - from + PAGE_BYTES - 1) / PAGE_BYTES : 0;
+  }
+  size_t r = 0;  // primeiro intervalo que pode conter a pagina
+  for (size_t i = 0; i < s.page_addresses.size(); i++) {
+    uint32_t address = s.page_addresses[i];
+    if (address % PAGE_BYTES != 0 ||
+        (i > 0 && address <= s.page_addresses[i - 1])) {
+      return false;
+    }
+    while (r < s.zero_runs.size() &&
+           s.zero_runs[r].address +
+                   (uint64_t)s.zero_runs[r].pages * PAGE_BYTES <=
+               address) {
+      r++;
+    }
+    if (r < s.zero_runs.size() && s.zero_runs[r].address <= address) {
+      return false;  // a pagina tambem esta num intervalo zerado
+    }
+    text_pages += address >= text_begin && address < text_end;
+  }
+  return header.text_size == 0 ||
+         text_pages == (text_end - text_begin + PAGE_BYTES - 1) / PAGE_BYTES;
+}
+
+// Le o snapshot gravado em fn. Devolve nulo se o arquivo nao abrir ou nao for
+// um snapshot valido.
+//
+shared_ptr<const Snapshot> load_snapshot(const char *fn) {
+  FILE *fptr = fopen(fn, "rb");
+  if (fptr == nullptr) {
+    return nullptr;
+  }
+  uint64_t size = 0;
+  if (fseek(fptr, 0, SEEK_END) == 0 && ftell(fptr) > 0) {
+    size = ftell(fptr);
+  }
+  rewind(fptr);
+  shared_ptr<Snapshot> s = make_shared<Snapshot>();
+  SnapshotHeader &header = s->header;
+  bool ok = fread(&header, sizeof(header), 1, fptr) == 1 &&
+            memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) == 0 &&
+            header.version == SNAPSHOT_VERSION &&
+            header.data_pages <= (1u << (32 - PAGE_BITS)) &&
+            snapshot_read(fptr, size, s->zero_runs, header.zero_runs) &&
+            snapshot_read(fptr, size, s->page_addresses, header.data_pages) &&
+            snapshot_read(fptr, size, s->contents,
+                          (size_t)header.data_pages * PAGE_WORDS) &&
+            snapshot_read(fptr, size, s->files, header.file_count);
+  for (uint32_t i = 0; ok && i < header.file_count; i++) {
+    const SnapshotFile &saved = s->files[i];
+    ok = saved.fd >= 3 && saved.fd < SNAPSHOT_MAX_FD &&
+         saved.name_size <= snapshot_remaining(fptr, size) &&
+         saved.mode[sizeof(saved.mode) - 1] == '\0';
+    string name(ok ? saved.name_size : 0, '\0');
+    ok = ok && fread(&name[0], 1, name.size(), fptr) == name.size();
+    s->file_names.push_back(name);
+  }
+  fclose(fptr);
+  return ok && snapshot_valid(*s) ? s : nullptr;
+}
+
+// Diz se o arquivo comeca com o magic do snapshot
+//
+bool is_snapshot(const char *fn) {
+  FILE *fptr = fopen(fn, "rb");
+  if (fptr == nullptr) {
+    return false;
+  }
+  char magic[sizeof(SNAPSHOT_MAGIC)];
+  bool snapshot = fread(magic, 1, sizeof(magic), fptr) == sizeof(magic) &&
+                  memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) == 0;
+  fclose(fptr);
+  return snapshot;
+}
+
+// Poe o hart no estado do snapshot. A memoria anterior e os arquivos abertos
+// sao descartados, e as paginas do snapshot sao usadas sem copia ate a
+// primeira escrita. variant volta em a0, como o retorno do ecall de snapshot.
+//
+void Hart::restore(shared_ptr<const Snapshot> snapshot, int32_t variant) {
+  const Snapshot &s = *snapshot;
+  const SnapshotHeader &header = s.header;
+  close_files(*this);
+  jit_release(jit);
+  jit = nullptr;
+  mem_release(&mem);
+  origin = snapshot;
+  mem.shared_base = (const uint8_t *)s.contents.data();
+  mem.shared_size = s.contents.size() * sizeof(int32_t);
+  for (const SnapshotRun &run : s.zero_runs) {
+    mem_map(&mem, run.address, run.pages * PAGE_BYTES);
+  }
+  for (size_t i = 0; i < s.page_addresses.size(); i++) {
+    mem_map_shared(&mem, s.page_addresses[i], &s.contents[i * PAGE_WORDS]);
+  }
+
+  memcpy(breg, header.breg, sizeof(breg));
+  breg[A0] = variant;
+  entry = header.pc;
+  sp = header.breg[SP];
+  gp = header.breg[GP];
+  init();
+  brk = header.brk;
+  set_text(header.text_start, header.text_size);
+
+  for (size_t i = 0; i < s.files.size(); i++) {
+    const SnapshotFile &saved = s.files[i];
+    // reabrir com "wb" apagaria o que o programa ja escreveu
+    const char *mode = strcmp(saved.mode, "wb") == 0 ? "r+b" : saved.mode;
+    FILE *fptr = fopen(s.file_names[i].c_str(), mode);
+    if (fptr != nullptr && fseek(fptr, saved.position, SEEK_SET) != 0) {
+      fclose(fptr);
+      fptr = nullptr;
+    }
+    if (files.size() <= (size_t)saved.fd) {
+      files.resize(saved.fd + 1, OpenFile{nullptr, "", ""});
+    }
+    files[saved.fd] = OpenFile{fptr, s.file_names[i], saved.mode};
+  }
+}
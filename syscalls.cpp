@@ -0,0 +1,389 @@
+/*
+ *  syscalls.cpp
+ *
+ * Chamadas de sistema (ecall) do RARS, com os numeros do Linux para read,
+ * write, close, lseek e exit. O servico vem em a7, os argumentos em a0..a2 e
+ * o resultado volta em a0. Cada servico e uma funcao da tabela syscall_table,
+ * indexada pelo numero, entao o ecall e um acesso a tabela em vez de um
+ * switch. Servicos desconhecidos sao ignorados.
+ *
+ * Strings e buffers de read/write sao copiados da memoria do hart em blocos
+ * de pagina (Hart::read_bytes/write_bytes), nunca palavra a palavra. Um
+ * buffer fora da memoria mapeada e uma falta, como num lw/sw.
+ *
+ * Os descritores 0, 1 e 2 sao o console do hart (stdout e stderr vao para a
+ * mesma saida, como no RARS). Os arquivos abertos com open ficam em
+ * Hart::files.
+ *
+ * O servico 1100 (snapshot) e proprio deste simulador, ver sys_snapshot.
+ */
+
+#include <chrono>
+
+enum {
+  SYS_PRINT_INT = 1,
+  SYS_PRINT_STRING = 4,
+  SYS_READ_INT = 5,
+  SYS_READ_STRING = 8,
+  SYS_SBRK = 9,
+  SYS_EXIT = 10,
+  SYS_PRINT_CHAR = 11,
+  SYS_READ_CHAR = 12,
+  SYS_EXIT2 = 17,
+  SYS_TIME = 30,
+  SYS_PRINT_HEX = 34,
+  SYS_PRINT_BINARY = 35,
+  SYS_PRINT_UNSIGNED = 36,
+  SYS_CLOSE = 57,
+  SYS_LSEEK = 62,
+  SYS_READ = 63,
+  SYS_WRITE = 64,
+  SYS_EXIT_LINUX = 93,
+  SYS_EXIT_GROUP = 94,
+  SYS_OPEN = 1024,
+  SYS_SNAPSHOT = 1100,
+  SYSCALL_COUNT
+};
+
+// Flags do open do RARS
+enum { OPEN_READ = 0, OPEN_WRITE = 1, OPEN_APPEND = 9 };
+
+enum { SYSCALL_CHUNK = 64 * 1024 };  // copias de read/write por partes
+
+// Um servico. Devolve true se o programa terminou.
+typedef bool (*Syscall)(Hart &h);
+
+// Arquivo do descritor, ou nulo se ele nao esta aberto
+//
+FILE *sys_file(Hart &h, int32_t fd) {
+  if (fd < 3 || (uint32_t)fd >= h.files.size()) {
+    return nullptr;
+  }
+  return h.files[fd].fptr;
+}
+
+// Le a string terminada em zero de address. Devolve false em caso de falta.
+//
+bool sys_string(Hart &h, uint32_t address, string &text) {
+  int64_t length = mem_strlen(&h.mem, address);
+  if (length < 0) {
+    return false;
+  }
+  text.resize(length);
+  return h.read_bytes(address, &text[0], length);
+}
+
+/******************************** CONSOLE ************************************/
+
+bool sys_print_int(Hart &h) {
+  h.console.put_int(h.breg[A0]);
+  return false;
+}
+
+bool sys_print_string(Hart &h) {
+  string text;
+  if (sys_string(h, h.breg[A0], text)) {
+    h.console.put(text.data(), text.size());
+  }
+  return false;
+}
+
+bool sys_print_char(Hart &h) {
+  h.console.put_char(h.breg[A0]);
+  return false;
+}
+
+bool sys_print_hex(Hart &h) {
+  char text[16];
+  snprintf(text, sizeof(text), "0x%08x", h.breg[A0]);
+  h.console.put(text);
+  return false;
+}
+
+bool sys_print_binary(Hart &h) {
+  char text[32];
+  for (int i = 0; i < 32; i++) {
+    text[i] = '0' + ((h.breg[A0] >> (31 - i)) & 1);
+  }
+  h.console.put(text, sizeof(text));
+  return false;
+}
+
+bool sys_print_unsigned(Hart &h) {
+  char text[16];
+  snprintf(text, sizeof(text), "%u", (uint32_t)h.breg[A0]);
+  h.console.put(text);
+  return false;
+}
+
+bool sys_read_int(Hart &h) {
+  char text[64];
+  size_t n = h.console.get_line(text, sizeof(text) - 1);
+  text[n] = '\0';
+  h.breg[A0] = strtol(text, nullptr, 0);
+  return false;
+}
+
+// Como o fgets: le ate a1 - 1 caracteres, incluindo o fim de linha, e termina
+// a string com zero
+//
+bool sys_read_string(Hart &h) {
+  int32_t size = h.breg[A1];
+  if (size < 1) {
+    return false;
+  }
+  vector<char> text(size);
+  size_t n = h.console.get_line(text.data(), size - 1);
+  text[n] = '\0';
+  h.write_bytes(h.breg[A0], text.data(), n + 1);
+  return false;
+}
+
+bool sys_read_char(Hart &h) {
+  h.breg[A0] = h.console.get_char();
+  return false;
+}
+
+/********************************* PROCESSO **********************************/
+
+bool sys_exit(Hart &h) {
+  h.exit_code = 0;
+  return true;
+}
+
+bool sys_exit_code(Hart &h) {
+  h.exit_code = h.breg[A0];
+  return true;
+}
+
+// Aumenta o heap em a0 bytes e devolve o inicio da area nova. As paginas sao
+// mapeadas zeradas e so ocupam memoria do host quando escritas.
+//
+bool sys_sbrk(Hart &h) {
+  int32_t size = h.breg[A0];
+  uint64_t end = h.brk + (((uint64_t)size + 3) & ~3ull);
+  if (size < 0 || end > ALLONE) {
+    h.breg[A0] = -1;
+    return false;
+  }
+  mem_map(&h.mem, h.brk, end - h.brk);
+  h.breg[A0] = h.brk;
+  h.brk = end;
+  return false;
+}
+
+// Milissegundos desde 1/1/1970: a parte baixa em a0 e a alta em a1
+//
+bool sys_time(Hart &h) {
+  uint64_t ms = chrono::duration_cast<chrono::milliseconds>(
+                    chrono::system_clock::now().time_since_epoch())
+                    .count();
+  h.breg[A0] = (uint32_t)ms;
+  h.breg[A1] = (uint32_t)(ms >> 32);
+  return false;
+}
+
+/********************************* ARQUIVOS **********************************/
+
+// a0 = nome, a1 = flags (OPEN_*). Devolve o descritor ou -1.
+//
+bool sys_open(Hart &h) {
+  string name;
+  if (!sys_string(h, h.breg[A0], name)) {
+    return false;
+  }
+  const char *mode;
+  switch (h.breg[A1]) {
+    case OPEN_READ:
+      mode = "rb";
+      break;
+    case OPEN_WRITE:
+      mode = "wb";
+      break;
+    case OPEN_APPEND:
+      mode = "ab";
+      break;
+    default:
+      h.breg[A0] = -1;
+      return false;
+  }
+  FILE *fptr = fopen(name.c_str(), mode);
+  if (fptr == nullptr) {
+    h.breg[A0] = -1;
+    return false;
+  }
+  if (h.files.size() < 3) {
+    h.files.resize(3, OpenFile{nullptr, "", ""});
+  }
+  size_t fd = 3;
+  while (fd < h.files.size() && h.files[fd].fptr != nullptr) {
+    fd++;
+  }
+  if (fd == h.files.size()) {
+    h.files.push_back(OpenFile{fptr, name, mode});
+  } else {
+    h.files[fd] = OpenFile{fptr, name, mode};
+  }
+  h.breg[A0] = fd;
+  return false;
+}
+
+bool sys_close(Hart &h) {
+  FILE *fptr = sys_file(h, h.breg[A0]);
+  if (fptr != nullptr) {
+    fclose(fptr);
+    h.files[h.breg[A0]] = OpenFile{nullptr, "", ""};
+    h.breg[A0] = 0;
+  } else {
+    h.breg[A0] = h.breg[A0] >= 0 && h.breg[A0] < 3 ? 0 : -1;
+  }
+  return false;
+}
+
+// a0 = descritor, a1 = deslocamento, a2 = origem (0 inicio, 1 atual, 2 fim).
+// Devolve a nova posicao ou -1.
+//
+bool sys_lseek(Hart &h) {
+  static const int whence[] = {SEEK_SET, SEEK_CUR, SEEK_END};
+  FILE *fptr = sys_file(h, h.breg[A0]);
+  if (fptr == nullptr || (uint32_t)h.breg[A2] > 2 ||
+      fseek(fptr, h.breg[A1], whence[h.breg[A2]]) != 0) {
+    h.breg[A0] = -1;
+  } else {
+    h.breg[A0] = ftell(fptr);
+  }
+  return false;
+}
+
+// a0 = descritor, a1 = buffer, a2 = tamanho. Devolve os bytes lidos ou -1.
+// Do console le no maximo uma linha, como de um terminal.
+//
+bool sys_read(Hart &h) {
+  int32_t fd = h.breg[A0];
+  uint32_t address = h.breg[A1];
+  int32_t size = h.breg[A2];
+  FILE *fptr = sys_file(h, fd);
+  if ((fd != 0 && fptr == nullptr) || size < 0) {
+    h.breg[A0] = -1;
+    return false;
+  }
+  vector<char> buffer(min(size, (int32_t)SYSCALL_CHUNK));
+  int32_t total = 0;
+  while (total < size) {
+    size_t room = min((size_t)(size - total), buffer.size());
+    size_t n = fd == 0 ? h.console.get_line(buffer.data(), room)
+                       : fread(buffer.data(), 1, room, fptr);
+    if (n == 0 || !h.write_bytes(address + total, buffer.data(), n)) {
+      break;
+    }
+    total += n;
+    if (n < room || fd == 0) {
+      break;
+    }
+  }
+  h.breg[A0] = total;
+  return false;
+}
+
+// a0 = descritor, a1 = buffer, a2 = tamanho. Devolve os bytes escritos ou -1.
+//
+bool sys_write(Hart &h) {
+  int32_t fd = h.breg[A0];
+  uint32_t address = h.breg[A1];
+  int32_t size = h.breg[A2];
+  FILE *fptr = sys_file(h, fd);
+  if ((fd != 1 && fd != 2 && fptr == nullptr) || size < 0) {
+    h.breg[A0] = -1;
+    return false;
+  }
+  vector<char> buffer(min(size, (int32_t)SYSCALL_CHUNK));
+  int32_t total = 0;
+  while (total < size) {
+    size_t room = min((size_t)(size - total), buffer.size());
+    if (!h.read_bytes(address + total, buffer.data(), room)) {
+      break;
+    }
+    if (fptr == nullptr) {
+      h.console.put(buffer.data(), room);
+    } else if (fwrite(buffer.data(), 1, room, fptr) < room) {
+      break;
+    }
+    total += room;
+  }
+  h.breg[A0] = total;
+  return false;
+}
+
+/********************************* SNAPSHOT **********************************/
+
+// Com -S (Hart::snapshot_path) grava o estado do hart, com o PC depois do
+// ecall, e termina o programa. Cada hart restaurado do snapshot volta deste
+// ecall com o numero da sua variante em a0, como o fork, entao o programa
+// pode fazer a parte comum uma vez e divergir depois. Sem -S devolve -1 e o
+// programa continua.
+//
+bool sys_snapshot(Hart &h) {
+  if (h.snapshot_path.empty()) {
+    h.breg[A0] = -1;
+    return false;
+  }
+  // o ecall nunca e comprimido
+  if (!save_snapshot(h, h.snapshot_path.c_str(), h.pc + 4)) {
+    h.print("\nErro: nao foi possivel gravar o snapshot\n");
+    h.breg[A0] = -1;
+    return false;
+  }
+  h.exit_reason = EXIT_SNAPSHOT;
+  return true;
+}
+
+/********************************** TABELA ***********************************/
+
+constexpr array<Syscall, SYSCALL_COUNT> build_syscalls() {
+  array<Syscall, SYSCALL_COUNT> syscall_table{};
+  syscall_table[SYS_PRINT_INT] = sys_print_int;
+  syscall_table[SYS_PRINT_STRING] = sys_print_string;
+  syscall_table[SYS_READ_INT] = sys_read_int;
+  syscall_table[SYS_READ_STRING] = sys_read_string;
+  syscall_table[SYS_SBRK] = sys_sbrk;
+  syscall_table[SYS_EXIT] = sys_exit;
+  syscall_table[SYS_PRINT_CHAR] = sys_print_char;
+  syscall_table[SYS_READ_CHAR] = sys_read_char;
+  syscall_table[SYS_EXIT2] = sys_exit_code;
+  syscall_table[SYS_TIME] = sys_time;
+  syscall_table[SYS_PRINT_HEX] = sys_print_hex;
+  syscall_table[SYS_PRINT_BINARY] = sys_print_binary;
+  syscall_table[SYS_PRINT_UNSIGNED] = sys_print_unsigned;
+  syscall_table[SYS_CLOSE] = sys_close;
+  syscall_table[SYS_LSEEK] = sys_lseek;
+  syscall_table[SYS_READ] = sys_read;
+  syscall_table[SYS_WRITE] = sys_write;
+  syscall_table[SYS_EXIT_LINUX] = sys_exit_code;
+  syscall_table[SYS_EXIT_GROUP] = sys_exit_code;
+  syscall_table[SYS_OPEN] = sys_open;
+  syscall_table[SYS_SNAPSHOT] = sys_snapshot;
+  return syscall_table;
+}
+
+constexpr array<Syscall, SYSCALL_COUNT> syscall_table = build_syscalls();
+
+// Executa o servico de a7. Devolve true se o programa terminou.
+//
+bool dispatch_syscall(Hart &h) {
+  uint32_t service = h.breg[A7];
+  if (service >= SYSCALL_COUNT || syscall_table[service] == nullptr) {
+    return false;
+  }
+  return syscall_table[service](h);
+}
+
+// Fecha os arquivos que o programa deixou abertos
+//
+void close_files(Hart &h) {
+  for (OpenFile &file : h.files) {
+    if (file.fptr != nullptr) {
+      fclose(file.fptr);
+    }
+  }
+  h.files.clear();
+}
@@ -0,0 +1,1024 @@
+# Teste do JIT (main.exe -e jit): entra 1000 vezes, cada vez um sw mais
+# adiante, numa sequencia de 1000 sw. Cada entrada traduz um bloco novo de
+# 64 sw, o maior bloco que o JIT gera, ate encher o buffer de codigo.
+# Roda com os dumps dumpteste4_text.bin/dumpteste4_data.bin como
+# code.bin/data.bin, e deve dar o mesmo resultado nos tres motores.
+.data
+area:	.word 0
+.text
+	la s1, area
+	li s2, 0
+	li s3, 4000
+laco:
+	la t0, stores
+	add t0, t0, s2
+	jalr ra, 0(t0)
+	addi s2, s2, 4
+	blt s2, s3, laco
+	li a7, 1
+	lw a0, 0(s1)
+	ecall		# imprime 4000
+	li a7, 10
+	ecall
+stores:
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	sw s3, 0(s1)
+	jalr zero, 0(ra)
@@ -0,0 +1,20 @@
+# Teste das atomicas com endereco desalinhado: o amoadd.w num endereco que
+# nao e multiplo de 4 e uma falta. O programa para no amoadd.w, sem mudar a
+# memoria nem o a0, com o erro das atomicas e o fim por falta de memoria:
+#   5Error in atomic access - address not multiple of 4!
+#   Erro: acesso a endereco nao mapeado 00002002 (PC = 0000001c)
+#   -- program is finished running (memory fault) --
+# Roda com os dumps dumpteste5_text.bin/dumpteste5_data.bin, nos tres motores.
+.data
+w:	.word 5
+.text
+	la s0, w
+	li a7, 1
+	lw a0, 0(s0)
+	ecall			# imprime 5
+	li a0, 7
+	addi t0, s0, 2
+	amoadd.w a0, a0, (t0)	# falta
+	ecall			# nao roda
+	li a7, 10
+	ecall
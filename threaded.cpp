@@ -0,0 +1,533 @@
+/*
+ *  threaded.cpp
+ *
+ * Motor alternativo de execucao (threaded code). Cada instrucao da cache de
+ * instrucoes decodificadas carrega um ponteiro para o seu handler, que executa
+ * a instrucao e ja avanca o PC (de 2 ou 4, conforme o tamanho da instrucao).
+ * O laco principal so busca a entrada do PC e chama o handler, sem passar pelo
+ * switch do execute().
+ *
+ * Pares comuns de instrucoes seguidas sao fundidos num so handler, que
+ * executa as duas com uma so passagem pelo laco (ver FUSAO).
+ *
+ * O motor de referencia continua sendo o run() de riscv.cpp.
+ */
+
+// Definidos em debug.cpp
+void h_break(Hart &h, const DecodedInstr &d);
+void debug_decoded(Hart &h, DecodedInstr &d);
+
+/********************************* HANDLERS **********************************/
+
+void h_add(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = h.breg[d.rs1] + h.breg[d.rs2];
+  h.pc += d.size;
+}
+
+void h_addi(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = h.breg[d.rs1] + d.imm;
+  h.pc += d.size;
+}
+
+void h_and(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = h.breg[d.rs1] & h.breg[d.rs2];
+  h.pc += d.size;
+}
+
+void h_andi(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = h.breg[d.rs1] & d.imm;
+  h.pc += d.size;
+}
+
+void h_auipc(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = h.pc + (d.imm << 12);
+  h.pc += d.size;
+}
+
+void h_beq(Hart &h, const DecodedInstr &d) {
+  h.pc += (h.breg[d.rs1] == h.breg[d.rs2]) ? d.imm : d.size;
+}
+
+void h_bne(Hart &h, const DecodedInstr &d) {
+  h.pc += (h.breg[d.rs1] != h.breg[d.rs2]) ? d.imm : d.size;
+}
+
+void h_bge(Hart &h, const DecodedInstr &d) {
+  h.pc += (h.breg[d.rs1] >= h.breg[d.rs2]) ? d.imm : d.size;
+}
+
+void h_bgeu(Hart &h, const DecodedInstr &d) {
+  h.pc += ((uint32_t)h.breg[d.rs1] >= (uint32_t)h.breg[d.rs2]) ? d.imm : d.size;
+}
+
+void h_blt(Hart &h, const DecodedInstr &d) {
+  h.pc += (h.breg[d.rs1] < h.breg[d.rs2]) ? d.imm : d.size;
+}
+
+void h_bltu(Hart &h, const DecodedInstr &d) {
+  h.pc += ((uint32_t)h.breg[d.rs1] < (uint32_t)h.breg[d.rs2]) ? d.imm : d.size;
+}
+
+void h_jal(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = h.pc + d.size;
+  h.pc += d.imm;
+}
+
+void h_jalr(Hart &h, const DecodedInstr &d) {
+  uint32_t address = (h.breg[d.rs1] + d.imm) & ~1u;
+  h.breg[d.rd] = h.pc + d.size;
+  h.pc = address;
+}
+
+void h_lb(Hart &h, const DecodedInstr &d) {
+  int32_t value = h.lb(h.breg[d.rs1], d.imm);
+  if (!h.mem.fault) {
+    h.breg[d.rd] = value;
+    h.pc += d.size;
+  }
+}
+
+void h_lbu(Hart &h, const DecodedInstr &d) {
+  int32_t value = h.lbu(h.breg[d.rs1], d.imm);
+  if (!h.mem.fault) {
+    h.breg[d.rd] = value;
+    h.pc += d.size;
+  }
+}
+
+void h_lw(Hart &h, const DecodedInstr &d) {
+  int32_t value = h.lw(h.breg[d.rs1], d.imm);
+  if (!h.mem.fault) {
+    h.breg[d.rd] = value;
+    h.pc += d.size;
+  }
+}
+
+void h_lui(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = d.imm << 12;
+  h.pc += d.size;
+}
+
+void h_or(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = h.breg[d.rs1] | h.breg[d.rs2];
+  h.pc += d.size;
+}
+
+void h_ori(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = h.breg[d.rs1] | d.imm;
+  h.pc += d.size;
+}
+
+void h_sb(Hart &h, const DecodedInstr &d) {
+  h.sb(h.breg[d.rs1], d.imm, h.breg[d.rs2] & BYTE1AND);
+  if (!h.mem.fault) {
+    h.pc += d.size;
+  }
+}
+
+void h_sw(Hart &h, const DecodedInstr &d) {
+  h.sw(h.breg[d.rs1], d.imm, h.breg[d.rs2]);
+  if (!h.mem.fault) {
+    h.pc += d.size;
+  }
+}
+
+void h_slli(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = h.breg[d.rs1] << d.imm;
+  h.pc += d.size;
+}
+
+void h_slt(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = h.breg[d.rs1] < h.breg[d.rs2] ? 1 : 0;
+  h.pc += d.size;
+}
+
+void h_sltu(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = (uint32_t)h.breg[d.rs1] < (uint32_t)h.breg[d.rs2] ? 1 : 0;
+  h.pc += d.size;
+}
+
+void h_srai(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = h.breg[d.rs1] >> d.imm;
+  h.pc += d.size;
+}
+
+void h_srli(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = (uint32_t)h.breg[d.rs1] >> d.imm;
+  h.pc += d.size;
+}
+
+void h_sub(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = h.breg[d.rs1] - h.breg[d.rs2];
+  h.pc += d.size;
+}
+
+void h_xor(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = h.breg[d.rs1] ^ h.breg[d.rs2];
+  h.pc += d.size;
+}
+
+void h_lh(Hart &h, const DecodedInstr &d) {
+  int32_t value = h.lh(h.breg[d.rs1], d.imm);
+  if (!h.mem.fault) {
+    h.breg[d.rd] = value;
+    h.pc += d.size;
+  }
+}
+
+void h_lhu(Hart &h, const DecodedInstr &d) {
+  int32_t value = h.lhu(h.breg[d.rs1], d.imm);
+  if (!h.mem.fault) {
+    h.breg[d.rd] = value;
+    h.pc += d.size;
+  }
+}
+
+void h_sh(Hart &h, const DecodedInstr &d) {
+  h.sh(h.breg[d.rs1], d.imm, h.breg[d.rs2] & 0xFFFF);
+  if (!h.mem.fault) {
+    h.pc += d.size;
+  }
+}
+
+void h_slti(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = h.breg[d.rs1] < d.imm ? 1 : 0;
+  h.pc += d.size;
+}
+
+void h_sltiu(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = (uint32_t)h.breg[d.rs1] < (uint32_t)d.imm ? 1 : 0;
+  h.pc += d.size;
+}
+
+void h_xori(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = h.breg[d.rs1] ^ d.imm;
+  h.pc += d.size;
+}
+
+void h_sll(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = (uint32_t)h.breg[d.rs1] << (h.breg[d.rs2] & 0x1F);
+  h.pc += d.size;
+}
+
+void h_srl(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = (uint32_t)h.breg[d.rs1] >> (h.breg[d.rs2] & 0x1F);
+  h.pc += d.size;
+}
+
+void h_sra(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = h.breg[d.rs1] >> (h.breg[d.rs2] & 0x1F);
+  h.pc += d.size;
+}
+
+void h_mul(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = (uint32_t)h.breg[d.rs1] * (uint32_t)h.breg[d.rs2];
+  h.pc += d.size;
+}
+
+void h_mulh(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = rv_mulh(h.breg[d.rs1], h.breg[d.rs2]);
+  h.pc += d.size;
+}
+
+void h_mulhsu(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = rv_mulhsu(h.breg[d.rs1], h.breg[d.rs2]);
+  h.pc += d.size;
+}
+
+void h_mulhu(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = rv_mulhu(h.breg[d.rs1], h.breg[d.rs2]);
+  h.pc += d.size;
+}
+
+void h_div(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = rv_div(h.breg[d.rs1], h.breg[d.rs2]);
+  h.pc += d.size;
+}
+
+void h_divu(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = rv_divu(h.breg[d.rs1], h.breg[d.rs2]);
+  h.pc += d.size;
+}
+
+void h_rem(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = rv_rem(h.breg[d.rs1], h.breg[d.rs2]);
+  h.pc += d.size;
+}
+
+void h_remu(Hart &h, const DecodedInstr &d) {
+  h.breg[d.rd] = rv_remu(h.breg[d.rs1], h.breg[d.rs2]);
+  h.pc += d.size;
+}
+
+void h_ecall(Hart &h, const DecodedInstr &d) {
+  h.stop_prg = h.sysECALL();
+  if (!h.mem.fault) {
+    h.pc += d.size;
+  }
+}
+
+void h_lr_w(Hart &h, const DecodedInstr &d) {
+  h.rLRW(d.rd, d.rs1);
+  if (!h.mem.fault) {
+    h.pc += d.size;
+  }
+}
+
+void h_sc_w(Hart &h, const DecodedInstr &d) {
+  h.rSCW(d.rd, d.rs1, d.rs2);
+  if (!h.mem.fault) {
+    h.pc += d.size;
+  }
+}
+
+// Todas as AMO*.W, a operacao vem da instrucao
+//
+void h_amo(Hart &h, const DecodedInstr &d) {
+  h.rAMOW(d.instruction, d.rd, d.rs1, d.rs2);
+  if (!h.mem.fault) {
+    h.pc += d.size;
+  }
+}
+
+void h_fence(Hart &h, const DecodedInstr &d) {
+  h.iFENCE();
+  h.pc += d.size;
+}
+
+// Instrucoes invalidas: so avanca o PC
+//
+void h_nop(Hart &h, const DecodedInstr &d) { h.pc += d.size; }
+
+constexpr array<Handler, I_nop + 1> build_handlers() {
+  array<Handler, I_nop + 1> handlers{};
+  for (Handler &handler : handlers) {
+    handler = h_nop;
+  }
+  handlers[I_add] = h_add;
+  handlers[I_addi] = h_addi;
+  handlers[I_and] = h_and;
+  handlers[I_andi] = h_andi;
+  handlers[I_auipc] = h_auipc;
+  handlers[I_beq] = h_beq;
+  handlers[I_bge] = h_bge;
+  handlers[I_bgeu] = h_bgeu;
+  handlers[I_blt] = h_blt;
+  handlers[I_bltu] = h_bltu;
+  handlers[I_bne] = h_bne;
+  handlers[I_jal] = h_jal;
+  handlers[I_jalr] = h_jalr;
+  handlers[I_lb] = h_lb;
+  handlers[I_lbu] = h_lbu;
+  handlers[I_lw] = h_lw;
+  handlers[I_lui] = h_lui;
+  handlers[I_or] = h_or;
+  handlers[I_ori] = h_ori;
+  handlers[I_sb] = h_sb;
+  handlers[I_sw] = h_sw;
+  handlers[I_slli] = h_slli;
+  handlers[I_slt] = h_slt;
+  handlers[I_sltu] = h_sltu;
+  handlers[I_srai] = h_srai;
+  handlers[I_srli] = h_srli;
+  handlers[I_sub] = h_sub;
+  handlers[I_xor] = h_xor;
+  handlers[I_lh] = h_lh;
+  handlers[I_lhu] = h_lhu;
+  handlers[I_sh] = h_sh;
+  handlers[I_slti] = h_slti;
+  handlers[I_sltiu] = h_sltiu;
+  handlers[I_xori] = h_xori;
+  handlers[I_sll] = h_sll;
+  handlers[I_srl] = h_srl;
+  handlers[I_sra] = h_sra;
+  handlers[I_fence] = h_fence;
+  handlers[I_mul] = h_mul;
+  handlers[I_mulh] = h_mulh;
+  handlers[I_mulhsu] = h_mulhsu;
+  handlers[I_mulhu] = h_mulhu;
+  handlers[I_div] = h_div;
+  handlers[I_divu] = h_divu;
+  handlers[I_rem] = h_rem;
+  handlers[I_remu] = h_remu;
+  handlers[I_ecall] = h_ecall;
+  handlers[I_lr_w] = h_lr_w;
+  handlers[I_sc_w] = h_sc_w;
+  for (int i = I_amoswap_w; i <= I_amomaxu_w; i++) {
+    handlers[i] = h_amo;
+  }
+  return handlers;
+}
+
+// Tabela de handlers indexada pela instrucao
+//
+constexpr array<Handler, I_nop + 1> handlers = build_handlers();
+
+/*********************************** FUSAO ***********************************/
+
+// Pares de instrucoes que o codigo compilado (e as pseudoinstrucoes do RARS)
+// sempre gera juntas:
+//   lui + addi           li com constante grande
+//   auipc + addi         la
+//   auipc + jalr         call e tail
+//   auipc + lw           lw de um rotulo
+//   addi + desvio        contador de laco
+//   slt* + beqz/bnez     comparacao seguida de desvio
+// O handler do par fica na entrada da primeira instrucao e chama os handlers
+// das duas, entao a semantica e exatamente a delas, inclusive o PC numa
+// falta da segunda. A segunda continua na sua entrada: um salto para ela a
+// executa sozinha, e uma escrita nela desfaz o par (invalidate_decoded).
+
+// Executa a instrucao d e a seguinte. A segunda so roda se ainda couber no
+// instret_limit, para o -l, as fatias do lockstep e os quanta do smp pararem
+// na instrucao certa.
+//
+template <Handler first, Handler second>
+void h_fused(Hart &h, const DecodedInstr &d) {
+  first(h, d);
+  if (h.instret + 2 <= h.instret_limit) {
+    h.instret++;
+    second(h, (&d)[d.size >> 1]);  // uma entrada por meia palavra
+  }
+}
+
+// Handler de first seguido do desvio condicional branch
+//
+template <Handler first>
+Handler fused_branch(INSTRUCTIONS branch) {
+  switch (branch) {
+    case I_beq:
+      return h_fused<first, h_beq>;
+    case I_bne:
+      return h_fused<first, h_bne>;
+    case I_blt:
+      return h_fused<first, h_blt>;
+    case I_bge:
+      return h_fused<first, h_bge>;
+    case I_bltu:
+      return h_fused<first, h_bltu>;
+    case I_bgeu:
+      return h_fused<first, h_bgeu>;
+    default:
+      return nullptr;
+  }
+}
+
+// Handler do par a, b, ou nulo se ele nao for um dos pares fundidos. A
+// primeira nunca escreve no x0, que so e zerado depois do handler.
+//
+Handler fused_handler(const DecodedInstr &a, const DecodedInstr &b) {
+  if (a.rd == ZERO) {
+    return nullptr;
+  }
+  bool chained = b.rs1 == a.rd;  // a segunda usa o resultado da primeira
+  bool test_zero = chained && b.rs2 == ZERO &&
+                   (b.instruction == I_beq || b.instruction == I_bne);
+  switch (a.instruction) {
+    case I_lui:
+      return chained && b.instruction == I_addi ? h_fused<h_lui, h_addi>
+                                                : nullptr;
+    case I_auipc:
+      if (!chained) {
+        return nullptr;
+      }
+      if (b.instruction == I_addi) {
+        return h_fused<h_auipc, h_addi>;
+      } else if (b.instruction == I_jalr) {
+        return h_fused<h_auipc, h_jalr>;
+      } else if (b.instruction == I_lw) {
+        return h_fused<h_auipc, h_lw>;
+      }
+      return nullptr;
+    case I_addi:
+      return fused_branch<h_addi>(b.instruction);
+    case I_slt:
+      return test_zero ? fused_branch<h_slt>(b.instruction) : nullptr;
+    case I_sltu:
+      return test_zero ? fused_branch<h_sltu>(b.instruction) : nullptr;
+    case I_slti:
+      return test_zero ? fused_branch<h_slti>(b.instruction) : nullptr;
+    case I_sltiu:
+      return test_zero ? fused_branch<h_sltiu>(b.instruction) : nullptr;
+    default:
+      return nullptr;
+  }
+}
+
+// Funde a instrucao em address com a seguinte, se as duas ja estao
+// decodificadas e formam um dos pares
+//
+void fuse_at(Hart &h, uint32_t address) {
+  if (!h.in_text(address)) {
+    return;
+  }
+  DecodedInstr &d = h.decoded(address);
+  if (!d.valid || d.handler != handlers[d.instruction] ||
+      !h.in_text(address + d.size)) {
+    return;
+  }
+  // a segunda nunca e um breakpoint do depurador, que tem que parar nela
+  const DecodedInstr &next = h.decoded(address + d.size);
+  Handler fused =
+      next.valid && next.handler != h_break ? fused_handler(d, next) : nullptr;
+  if (fused != nullptr) {
+    d.handler = fused;
+    d.fused = true;
+  }
+}
+
+/********************************** DECODE ***********************************/
+
+// Handler das entradas ainda nao decodificadas. Faz o fetch/decode completo,
+// instala o handler da instrucao na cache e ja a executa. A instrucao pode
+// formar um par com a seguinte ou com a anterior (de 2 ou de 4 bytes). Com
+// o depurador ligado o handler pode ser trocado pelo de um watchpoint.
+//
+void h_decode(Hart &h, const DecodedInstr &) {
+  h.fetch_decoded();
+  if (h.mem.fault) {
+    return;
+  }
+  DecodedInstr &d = h.decoded(h.pc);
+  if (!d.valid) {
+    // instrucao invalida, o erro ja foi impresso pelo decode
+    h.pc += h.ilen;
+    return;
+  }
+  d.handler = handlers[d.instruction];
+  d.fused = false;
+  fuse_at(h, h.pc);
+  fuse_at(h, h.pc - 2);
+  fuse_at(h, h.pc - 4);
+  if (h.debugger != nullptr) {
+    debug_decoded(h, d);
+  }
+  d.handler(h, d);
+}
+
+/********************************** ENGINE ***********************************/
+
+// Motor threaded: cada handler deixa o PC apontando para a proxima instrucao
+// (ou na propria instrucao, se ela faltou), entao o laco so encadeia as
+// chamadas. PC impar volta para o step() de referencia, que imprime o erro
+// do fetch.
+//
+void Hart::run_threaded() {
+  init();
+  clear_decoded();
+  resume_threaded();
+  report_finish();
+}
+
+void Hart::resume_threaded() {
+  while (running()) {
+    if ((pc & 1) != 0) {
+      step();
+      continue;
+    }
+    const DecodedInstr &d = decoded(pc);
+    d.handler(*this, d);
+    breg[ZERO] = 0;
+    instret++;
+  }
+}
@@ -0,0 +1,522 @@
+/*
+ *  trace.cpp
+ *
+ * Trace binario da execucao: um registro por instrucao completada com o PC,
+ * a instrucao (ri), o valor escrito em rd e, nos loads, stores e atomicas, o
+ * endereco e o valor escrito. O trace tem o seu proprio laco
+ * (Hart::run_traced), entao o run() normal nao paga nada quando ele esta
+ * desligado.
+ *
+ * Os registros sao compactos porque quase tudo e previsivel a partir do
+ * estado anterior, que o leitor reconstroi do mesmo jeito que o gravador:
+ *   - o PC so aparece quando nao e o seguinte ao da instrucao anterior, como
+ *     diferenca para ele;
+ *   - a instrucao so aparece quando muda o que esta guardado para aquele PC
+ *     (a primeira execucao ou codigo automodificado);
+ *   - o valor de rd e a diferenca para o valor anterior do registrador;
+ *   - o endereco de memoria e a diferenca para o do acesso anterior.
+ * Os numeros usam varint (7 bits por byte) com zigzag para os negativos, e
+ * laco tipico custa 2 a 4 bytes por instrucao. Depois de um ecall os
+ * registradores que o servico mudou vao num registro a parte (TRACE_REGS).
+ *
+ * O hart enche um de dois buffers enquanto uma thread grava o outro no
+ * disco, entao a execucao so espera quando o disco nao acompanha.
+ *
+ * Formato: TraceHeader e depois os registros, cada um com um byte de flags
+ * (TRACE_*) seguido dos campos presentes, na ordem das flags. O leitor
+ * (read_trace, main.exe -T) imprime o trace em texto.
+ */
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+enum { TRACE_BUFFER = 1 << 20 };  // bytes de cada um dos dois buffers
+enum { TRACE_RECORD_MAX = 256 };  // maior registro possivel
+
+enum : uint32_t { TRACE_VERSION = 1 };
+
+const char TRACE_MAGIC[8] = {'R', 'V', '3', '2', 'T', 'R', 'C', 'E'};
+
+// Flags do primeiro byte de cada registro
+enum {
+  TRACE_JUMP = 1,         // PC: diferenca para o PC seguinte ao anterior
+  TRACE_RI = 2,           // instrucao nova para este PC
+  TRACE_COMPRESSED = 4,   // instrucao de 16 bits (ri e a forma expandida)
+  TRACE_RD = 8,           // rd: diferenca para o valor anterior
+  TRACE_LOAD = 16,        // endereco: diferenca para o acesso anterior
+  TRACE_STORE = 32,       // endereco como no load e o valor escrito
+  TRACE_REGS = 64         // mascara e diferencas dos registradores mudados
+};
+
+// Estado inicial do hart, de onde o leitor parte
+//
+struct TraceHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t pc, text_start, text_size;
+  int32_t breg[32];
+};
+
+static_assert(sizeof(TraceHeader) == 152, "cabecalho do trace");
+
+struct Trace {
+  string path;
+  FILE *out;
+
+  // Buffers: o hart enche o ativo enquanto a thread grava o outro
+  vector<uint8_t> buffers[2];
+  int active;
+  uint8_t *cursor, *limit;
+  thread writer;
+  mutex m;
+  condition_variable cv;
+  int full;        // buffer entregue para a thread
+  size_t pending;  // bytes dele ainda nao gravados, 0 se nada
+  bool done;       // nao vem mais nada
+  bool failed;     // alguma escrita falhou
+
+  // Estado do codificador, reconstruido igual pelo leitor
+  uint32_t next_pc;         // PC seguinte ao da instrucao anterior
+  uint32_t last_address;    // endereco do acesso anterior
+  int32_t regs[32];         // registradores como o leitor os ve
+  uint32_t text_start;
+  vector<uint32_t> words;   // ri de cada meia palavra do texto
+};
+
+Trace *trace_new(const char *path) {
+  Trace *t = new Trace;
+  t->path = path;
+  t->out = nullptr;
+  return t;
+}
+
+/******************************** CODIFICACAO ********************************/
+
+uint32_t zigzag(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+int32_t unzigzag(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+inline uint8_t *put_varint(uint8_t *p, uint32_t value) {
+  while (value >= 0x80) {
+    *p++ = (uint8_t)value | 0x80;
+    value >>= 7;
+  }
+  *p++ = (uint8_t)value;
+  return p;
+}
+
+/********************************* GRAVACAO **********************************/
+
+// Laco da thread de gravacao: espera um buffer cheio, grava e devolve
+//
+void trace_writer(Trace *t) {
+  unique_lock<mutex> lock(t->m);
+  while (true) {
+    t->cv.wait(lock, [t] { return t->pending != 0 || t->done; });
+    if (t->pending == 0) {
+      return;
+    }
+    const uint8_t *data = t->buffers[t->full].data();
+    size_t n = t->pending;
+    lock.unlock();
+    bool ok = fwrite(data, 1, n, t->out) == n;
+    lock.lock();
+    t->failed = t->failed || !ok;
+    t->pending = 0;
+    t->cv.notify_all();
+  }
+}
+
+// Entrega o buffer ativo para a thread e passa a encher o outro. So espera
+// se a thread ainda esta gravando o outro.
+//
+void trace_swap(Trace &t) {
+  unique_lock<mutex> lock(t.m);
+  t.cv.wait(lock, [&t] { return t.pending == 0; });
+  t.pending = t.cursor - t.buffers[t.active].data();
+  t.full = t.active;
+  t.active ^= 1;
+  t.cursor = t.buffers[t.active].data();
+  t.limit = t.cursor + TRACE_BUFFER - TRACE_RECORD_MAX;
+  t.cv.notify_all();
+}
+
+// Abre o arquivo, grava o estado inicial do hart e liga a thread. Devolve
+// false se o arquivo nao abrir.
+//
+bool trace_start(Trace &t, Hart &h) {
+  t.out = fopen(t.path.c_str(), "wb");
+  if (t.out == nullptr) {
+    return false;
+  }
+  TraceHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+  header.version = TRACE_VERSION;
+  header.pc = h.pc;
+  header.text_start = h.text_start;
+  header.text_size = h.text_size;
+  memcpy(header.breg, h.breg, sizeof(header.breg));
+  t.failed = fwrite(&header, sizeof(header), 1, t.out) != 1;
+
+  for (vector<uint8_t> &buffer : t.buffers) {
+    buffer.resize(TRACE_BUFFER);
+  }
+  t.active = 0;
+  t.cursor = t.buffers[0].data();
+  t.limit = t.cursor + TRACE_BUFFER - TRACE_RECORD_MAX;
+  t.full = 0;
+  t.pending = 0;
+  t.done = false;
+  t.next_pc = h.pc;
+  t.last_address = 0;
+  memcpy(t.regs, h.breg, sizeof(t.regs));
+  t.text_start = h.text_start;
+  t.words.assign(h.text_size >> 1, 0);
+  t.writer = thread(trace_writer, &t);
+  return true;
+}
+
+// Grava o que sobrou e fecha o arquivo. Devolve false se alguma escrita
+// falhou.
+//
+bool trace_finish(Trace &t) {
+  if (t.out == nullptr) {
+    return false;
+  }
+  trace_swap(t);
+  {
+    lock_guard<mutex> lock(t.m);
+    t.done = true;
+  }
+  t.cv.notify_all();
+  t.writer.join();
+  bool ok = fclose(t.out) == 0 && !t.failed;
+  t.out = nullptr;
+  return ok;
+}
+
+void trace_release(Trace *t) {
+  if (t != nullptr) {
+    trace_finish(*t);
+  }
+  delete t;
+}
+
+// Registradores mudados por um ecall: mascara e diferencas. Devolve o fim
+// do que foi escrito em p.
+//
+uint8_t *trace_registers(Trace &t, Hart &h, uint8_t *p) {
+  uint32_t mask = 0;
+  for (int i = 1; i < 32; i++) {
+    if (h.breg[i] != t.regs[i]) {
+      mask |= 1u << i;
+    }
+  }
+  p = put_varint(p, mask);
+  for (int i = 1; i < 32; i++) {
+    if (mask & (1u << i)) {
+      p = put_varint(p, zigzag(h.breg[i] - t.regs[i]));
+      t.regs[i] = h.breg[i];
+    }
+  }
+  return p;
+}
+
+// Grava o registro da instrucao que acabou de completar. word e a instrucao,
+// size o tamanho dela, address e value o endereco e o dado de um load/store
+// calculados antes do execute. Uma atomica e gravada como store se escreveu
+// (stored, com o valor escrito em value) e como load se nao. Tudo e lido
+// antes de escrever no buffer: as escritas de bytes podem apontar para
+// qualquer lugar e obrigariam o compilador a reler os registradores depois
+// de cada uma.
+//
+inline void trace_record(Trace &t, Hart &h, uint32_t at, uint32_t word,
+                         uint32_t size, uint32_t address, int32_t value,
+                         bool stored) {
+  uint32_t opcode = word & 0x7F;
+  uint32_t rd = (word >> 7) & 0x1F;
+  uint32_t flags = size == 2 ? TRACE_COMPRESSED : 0;
+  uint32_t jump = zigzag(at - t.next_pc);
+  t.next_pc = at + size;
+  uint32_t &known = t.words[(at - t.text_start) >> 1];
+  bool new_word = known != word;
+  known = word;
+  uint32_t rd_delta = 0;
+  if (rd != 0 && opcode != StoreType && opcode != BType && opcode != ECALL &&
+      opcode != FENCE) {
+    flags |= TRACE_RD;
+    rd_delta = zigzag(h.breg[rd] - t.regs[rd]);
+    t.regs[rd] = h.breg[rd];
+  }
+  uint32_t address_delta = zigzag(address - t.last_address);
+  if (opcode == ILType || opcode == StoreType || opcode == AMO) {
+    bool store = opcode == StoreType || (opcode == AMO && stored);
+    flags |= store ? TRACE_STORE : TRACE_LOAD;
+    t.last_address = address;
+  }
+
+  uint8_t *p = t.cursor + 1;
+  if (jump != 0) {
+    flags |= TRACE_JUMP;
+    p = put_varint(p, jump);
+  }
+  if (new_word) {
+    flags |= TRACE_RI;
+    p = put_varint(p, word);
+  }
+  if (flags & TRACE_RD) {
+    p = put_varint(p, rd_delta);
+  }
+  if (flags & (TRACE_LOAD | TRACE_STORE)) {
+    p = put_varint(p, address_delta);
+  }
+  if (flags & TRACE_STORE) {
+    p = put_varint(p, zigzag(value));
+  }
+  if (opcode == ECALL) {
+    uint8_t *start = p;
+    p = trace_registers(t, h, p);
+    if (p - start > 1) {
+      flags |= TRACE_REGS;
+    } else {
+      p = start;  // nada mudou
+    }
+  }
+  *t.cursor = flags;
+  t.cursor = p;
+  if (p > t.limit) {
+    trace_swap(t);
+  }
+}
+
+/********************************** ENGINE ***********************************/
+
+// Motor de referencia com o trace ligado. O decode e o execute sao feitos
+// separados (fetch_decoded/retire) para ler o endereco e o dado dos
+// loads/stores antes do execute mudar os registradores.
+//
+void Hart::run_traced() {
+  init();
+  clear_decoded();
+  if (!trace_start(*trace, *this)) {
+    printf("Nao foi possivel gravar o trace em %s\n", trace->path.c_str());
+    run();
+    return;
+  }
+  while (running()) {
+    uint32_t at = pc;
+    // sem decode novo ri esta velho; a instrucao e a guardada pelo trace
+    bool fresh = (pc & 1) != 0 || !decoded(pc).valid;
+    instret++;
+    fetch_decoded();
+    if (mem.fault) {
+      break;
+    }
+    uint32_t word = fresh ? ri : trace->words[(at - text_start) >> 1];
+    uint32_t size = ilen;
+    uint32_t address = breg[rs1] + imm32_t;
+    int32_t value = breg[rs2];
+    // o que uma atomica escreve so se sabe depois do execute
+    bool atomic = (word & 0x7F) == AMO;
+    vector<StoreRecord> written;
+    if (atomic) {
+      stores = &written;
+    }
+    retire();
+    if (atomic) {
+      stores = nullptr;
+      value = written.empty() ? 0 : written[0].value;
+    }
+    if (!mem.fault) {
+      trace_record(*trace, *this, at, word, size, address, value,
+                   !written.empty());
+    }
+  }
+  report_finish();
+  if (!trace_finish(*trace)) {
+    printf("Erro ao gravar o trace em %s\n", trace->path.c_str());
+  }
+}
+
+/********************************** LEITURA **********************************/
+
+// Le um varint. Devolve false no fim do arquivo.
+//
+bool get_varint(FILE *fptr, uint32_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    int c = getc(fptr);
+    if (c == EOF) {
+      return false;
+    }
+    value |= (uint32_t)(c & 0x7F) << shift;
+    if ((c & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Leitor do trace. Refaz o estado do codificador a partir do cabecalho, entao
+// regs tem sempre os registradores depois da ultima instrucao lida.
+//
+struct TraceReader {
+  FILE *in;
+  TraceHeader header;
+  int32_t regs[32];
+  vector<uint32_t> words;  // instrucao de cada meia palavra do texto
+  uint32_t next_pc, last_address;
+  uint64_t count;  // instrucoes lidas
+};
+
+// Instrucao lida do trace. rd, address e value so valem com as flags
+// correspondentes; regs_mask diz quais registradores o ecall mudou.
+//
+struct TraceEntry {
+  int flags;
+  uint32_t pc, word, address, regs_mask;
+  int32_t value;
+};
+
+// Abre o trace gravado em fn. Devolve false, com a mensagem impressa, se o
+// arquivo nao abrir ou nao for um trace.
+//
+bool trace_open(TraceReader &r, const char *fn) {
+  r.in = fopen(fn, "rb");
+  if (r.in == nullptr) {
+    printf("Trace nao encontrado: %s\n", fn);
+    return false;
+  }
+  if (fread(&r.header, sizeof(r.header), 1, r.in) != 1 ||
+      memcmp(r.header.magic, TRACE_MAGIC, sizeof(r.header.magic)) != 0 ||
+      r.header.version != TRACE_VERSION) {
+    printf("Trace invalido: %s\n", fn);
+    fclose(r.in);
+    r.in = nullptr;
+    return false;
+  }
+  memcpy(r.regs, r.header.breg, sizeof(r.regs));
+  r.words.assign(r.header.text_size >> 1, 0);
+  r.next_pc = r.header.pc;
+  r.last_address = 0;
+  r.count = 0;
+  return true;
+}
+
+void trace_close(TraceReader &r) {
+  if (r.in != nullptr) {
+    fclose(r.in);
+    r.in = nullptr;
+  }
+}
+
+// Le a proxima instrucao. Devolve 1 se leu, 0 no fim do trace e -1 se o
+// trace esta truncado.
+//
+int trace_next(TraceReader &r, TraceEntry &e) {
+  e.flags = getc(r.in);
+  if (e.flags == EOF) {
+    return 0;
+  }
+  uint32_t field = 0;
+  bool ok = true;
+  e.pc = r.next_pc;
+  if (e.flags & TRACE_JUMP) {
+    ok = get_varint(r.in, field);
+    e.pc += unzigzag(field);
+  }
+  uint32_t index = (e.pc - r.header.text_start) >> 1;
+  if (index >= r.words.size()) {
+    return -1;
+  }
+  if (e.flags & TRACE_RI) {
+    ok = ok && get_varint(r.in, r.words[index]);
+  }
+  e.word = r.words[index];
+  if (e.flags & TRACE_RD) {
+    ok = ok && get_varint(r.in, field);
+    r.regs[(e.word >> 7) & 0x1F] += unzigzag(field);
+  }
+  if (e.flags & (TRACE_LOAD | TRACE_STORE)) {
+    ok = ok && get_varint(r.in, field);
+    r.last_address += unzigzag(field);
+  }
+  e.address = r.last_address;
+  e.value = 0;
+  if (e.flags & TRACE_STORE) {
+    ok = ok && get_varint(r.in, field);
+    e.value = unzigzag(field);
+  }
+  e.regs_mask = 0;
+  if (e.flags & TRACE_REGS) {
+    ok = ok && get_varint(r.in, e.regs_mask);
+    for (int i = 1; ok && i < 32; i++) {
+      if (e.regs_mask & (1u << i)) {
+        ok = get_varint(r.in, field);
+        r.regs[i] += unzigzag(field);
+      }
+    }
+  }
+  if (!ok) {
+    return -1;
+  }
+  // o proximo PC previsto e o seguinte a este; desvios vem com TRACE_JUMP
+  r.next_pc = e.pc + ((e.flags & TRACE_COMPRESSED) ? 2 : 4);
+  r.count++;
+  return 1;
+}
+
+// Imprime uma instrucao: PC, instrucao (a forma expandida, marcada com c se
+// for comprimida) e o texto do desmontador
+//
+void print_instr(uint32_t pc, uint32_t word, bool compressed) {
+  char text[64];
+  disassemble(text, sizeof(text), pc, word);
+  printf("%08x  %08x %c  %-30s", pc, word, compressed ? 'c' : ' ', text);
+}
+
+// Imprime o trace gravado em fn, uma instrucao por linha:
+//   PC  instrucao [c]  texto  rd = valor  [endereco] (<- valor do store)
+// Devolve -1 se o arquivo nao abrir ou nao for um trace.
+//
+int read_trace(const char *fn) {
+  TraceReader r;
+  if (!trace_open(r, fn)) {
+    return -1;
+  }
+  TraceEntry e;
+  int status;
+  while ((status = trace_next(r, e)) > 0) {
+    print_instr(e.pc, e.word, e.flags & TRACE_COMPRESSED);
+    uint32_t rd = (e.word >> 7) & 0x1F;
+    if (e.flags & TRACE_RD) {
+      printf("  %s = %08x", reg_str[rd], r.regs[rd]);
+    }
+    if (e.flags & (TRACE_LOAD | TRACE_STORE)) {
+      printf("  [%08x]", e.address);
+    }
+    if (e.flags & TRACE_STORE) {
+      printf(" <- %08x", e.value);
+    }
+    for (int i = 1; i < 32; i++) {
+      if (e.regs_mask & (1u << i)) {
+        printf("  %s = %08x", reg_str[i], r.regs[i]);
+      }
+    }
+    printf("\n");
+  }
+  trace_close(r);
+  if (status < 0) {
+    printf("Trace truncado depois de %llu instrucoes\n",
+           (unsigned long long)r.count);
+    return -1;
+  }
+  printf("%llu instrucoes\n", (unsigned long long)r.count);
+  return 0;
+}